@@ -0,0 +1,76 @@
+#ifndef _BATCH_PIPELINE_H_
+#define _BATCH_PIPELINE_H_
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "CardDetector.h"
+#include "DetectionWorker.h"
+#include "ResultsStream.h"
+
+
+struct BatchOptions
+{
+	int readers = 2;			// Threads decoding images
+	int workers = 2;			// Threads running a detector each
+	size_t prefetch = 8;		// Decoded images waiting for a worker
+	int reduction = 1;			// Decode at 1/2, 1/4 or 1/8 resolution, see ReducedImage
+	TileOptions tiling;			// For full resolution images
+	DetectorSettings settings;
+};
+
+
+// Time one stage of the pipeline spent working rather than waiting on a queue
+struct StageUsage
+{
+	int threads = 0;
+	double busy_ms = 0;			// Summed over the threads
+
+	double utilization(double elapsed_ms) const { return threads > 0 && elapsed_ms > 0 ? busy_ms / (threads * elapsed_ms) : 0; }
+};
+
+
+// Items waiting in a queue whenever its consumer came for the next one
+struct QueueUsage
+{
+	size_t capacity = 0;
+	double mean_depth = 0;
+	size_t max_depth = 0;
+};
+
+
+struct BatchReport
+{
+	size_t images = 0;
+	size_t failed = 0;			// Images that could not be decoded
+	double elapsed_ms = 0;
+	StageUsage read;
+	StageUsage recognize;
+	StageUsage write;
+	StageUsage full_decode;		// Full resolution decodes --reduce needed, done by the workers and not counted as recognition
+	QueueUsage prefetch;		// Decoded images waiting for a worker
+	QueueUsage results;			// Recognized images waiting for the writer
+	size_t cut_outlines = 0;	// Of tiled images, see DetectionResult::cut_outlines
+};
+
+
+/*
+Recognizes a list of images with decoding, recognition and output overlapped.
+
+Reader threads decode the upcoming images into a bounded prefetch queue, worker threads
+with a detector each take them from there, and a single writer puts the results back in
+input order: one JSON line per image to `out` and, when given, a record to `results`.
+Readers only start on an image once it is within a fixed window of the last one written,
+so a slow image holds up at most that many others and memory stays bounded.
+
+A full prefetch queue with busy workers calls for more workers, an empty one with busy
+readers for more readers.
+*/
+BatchReport runBatch(const std::vector<std::string>& paths, const BatchOptions& options, std::ostream& out, ResultsWriter* results);
+
+// Image paths listed one per line, relative to the list file unless absolute, # starts a comment
+std::vector<std::string> loadImageList(const std::string& path);
+
+#endif // _BATCH_PIPELINE_H_
@@ -0,0 +1,90 @@
+#ifndef _BOUNDED_QUEUE_H_
+#define _BOUNDED_QUEUE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+
+/*
+Fixed capacity multi producer, multi consumer queue.
+
+Producers choose between waiting for space (push) and being turned away (tryPush),
+which is how callers apply backpressure. After close() no new items are accepted and
+consumers drain what is left before pop() returns false.
+*/
+template <typename T>
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue(size_t capacity) : m_capacity(capacity > 0 ? capacity : 1) {}
+
+	// Waits for space, false when the queue was closed
+	bool push(T item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_not_full.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+		if (m_closed)
+		{
+			return false;
+		}
+		m_items.push_back(std::move(item));
+		m_not_empty.notify_one();
+		return true;
+	}
+
+	// False when the queue is full or closed, the item is left untouched then
+	bool tryPush(T& item)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_closed || m_items.size() >= m_capacity)
+		{
+			return false;
+		}
+		m_items.push_back(std::move(item));
+		m_not_empty.notify_one();
+		return true;
+	}
+
+	// Waits for an item, false once the queue is closed and empty
+	bool pop(T& item)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_not_empty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+		if (m_items.empty())
+		{
+			return false;
+		}
+		item = std::move(m_items.front());
+		m_items.pop_front();
+		m_not_full.notify_one();
+		return true;
+	}
+
+	void close()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_closed = true;
+		m_not_empty.notify_all();
+		m_not_full.notify_all();
+	}
+
+	size_t size() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_items.size();
+	}
+
+	size_t capacity() const { return m_capacity; }
+
+private:
+	const size_t m_capacity;
+	std::deque<T> m_items;
+	bool m_closed = false;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_not_empty;
+	std::condition_variable m_not_full;
+};
+
+#endif // _BOUNDED_QUEUE_H_
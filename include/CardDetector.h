@@ -0,0 +1,211 @@
+#ifndef _CARD_DETECTOR_H_
+#define _CARD_DETECTOR_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+#include "opencv2/gapi.hpp"
+
+#include "FrameBuffer.h"
+#include "GlyphClassifier.h"
+#include "ReducedImage.h"
+#include "StageTimings.h"
+
+
+struct CannyParameters
+{
+	int low_threshold = 0;
+	int high_threshold = 255;
+};
+
+
+struct GaussianParameters
+{
+	int kernel_size = 3;
+	int sigma = 0;
+};
+
+
+struct ThresholdParameters
+{
+	int threshold = 100;
+	int max = 255;
+	int type = cv::THRESH_BINARY;
+};
+
+
+/*
+Splitting of frames too large for the front end to filter at once, such as 8K table scans.
+
+A card is only found by a tile that holds it whole, tiles drop outlines that cross a border
+shared with another tile and duplicates are merged by their midpoint. A card wider or taller
+than the overlap can cross a border in every tile that touches it and is lost, which shows
+in DetectionResult::cut_outlines. The blur, edge and contour buffers are tile sized, but the
+frame is still converted to gray once at full size, recognition warps the cards out of it.
+*/
+struct TileOptions
+{
+	int tile_size = 0;		// Width and height of the square tiles, 0 filters whole frames
+	int overlap = 512;		// Must exceed the largest card extent, at most half a tile is used
+	int threads = 0;		// Tiles filtered in parallel, 0 for one per core
+	bool output = false;	// Also draw the Output stage, over a copy of the whole frame
+};
+
+
+// Recognition result for a single card
+struct CardResult
+{
+	std::vector<cv::Point> quad;	// Approximated card outline in frame coordinates
+	cv::Point2f midpoint;
+	std::string rank;
+	std::string suit;
+	int rank_score = 0;				// Pixels differing from the best rank template at template size, lower is better
+	int suit_score = 0;				// Pixels differing from the best suit template at template size, lower is better
+	float rank_confidence = 0;		// Margin to the runner-up template, 0 for a tie to 1 for no doubt
+	float suit_confidence = 0;
+};
+
+
+// Everything produced by one pass of the detector over a frame
+struct DetectionResult
+{
+	std::unordered_map<std::string, cv::Mat> pipe_out;
+	std::vector<std::unordered_map<std::string, cv::Mat>> card_data;
+	std::vector<CardResult> cards;
+	size_t bytes_copied = 0;		// Pixel bytes copied rather than computed while producing this result
+	StageTimings timings;
+	GlyphClassifier::Stats rank_stats;	// How the rank and suit templates were narrowed down and compared
+	GlyphClassifier::Stats suit_stats;
+	size_t reverified = 0;			// Rank and suit glyphs that were not confident enough and got looked at again
+	size_t warps_reused = 0;		// Cards rectified from the tables cached for them in the previous frame
+	size_t cut_outlines = 0;		// Tiled frames: card sized outlines crossing a tile border that no tile holds whole
+	size_t disagreements = 0;		// Cross checked glyphs the per card reference matcher labels differently
+};
+
+
+/*
+Locates cards in a BGR frame and identifies their rank and suit by comparing
+the top left index of each card against the templates in `images/`.
+*/
+class CardDetector
+{
+public:
+	explicit CardDetector(const std::string& template_dir = "images/");
+
+	// Run the full pipeline on a BGR frame, the frame itself is left untouched.
+	// Stage images reference detector owned buffers that are reused two frames later,
+	// unless the caller still holds a reference to them.
+	void process(const cv::Mat& color, DetectionResult& result);
+
+	// Same as process() for frames larger than a tile, but blur, Canny and the contour search
+	// run on overlapping tiles in parallel with tile sized buffers instead of several frame sized
+	// ones. Cards are found in the tiles that hold them whole, see TileOptions for the limits.
+	// Of the stage images only Output is made, and only when the options ask for it.
+	void processTiled(const cv::Mat& color, const TileOptions& options, DetectionResult& result);
+
+	// Finds the cards in the reduced image and reads their index there too, unless a card is
+	// smaller than the smallest labeled ones. Only then is the full resolution decoded, once for
+	// all cards, and the indexes are warped straight from its colors.
+	// Reported outlines are in full resolution coordinates, no stage images are made.
+	void processReduced(ReducedImage& image, DetectionResult& result);
+
+	GaussianParameters gauss_params;
+	CannyParameters canny_params;
+
+	// Rank and suit matches below this confidence are verified with both index corners at
+	// twice the resolution against every template, 0 never verifies, above 1 always does
+	float verify_below = 0.5f;
+
+	// Warp whole cards and draw the per card stage images for the viewer,
+	// otherwise the card stages are views of the recognition buffers only
+	bool card_views = true;
+
+	// Keep the Source, Blurred, Equalized and Edges outputs of the front end and draw the
+	// Contours, Rectangle Contours and Output overlays, otherwise only the cards are reported
+	bool stage_images = true;
+
+	// Also label every glyph with the per card matcher the batched classifier replaced, each
+	// template resized to the glyph and compared with absdiff, and count the glyphs where the two
+	// disagree before verification. Slow, for the regression suite.
+	bool cross_check = false;
+
+private:
+	// Compiles the front end graph for the format of gray and the current parameters,
+	// unless the graph compiled for an earlier frame still matches them
+	cv::GCompiled& frontEnd(const cv::Mat& gray);
+
+	// Everything after the front end, from the contours of the whole frame. Contours are in the
+	// coordinates of cards, scale times those are frame coordinates, in which the outlines are
+	// reported and the cards tracked from frame to frame. cards is gray, or the BGR frame itself,
+	// then only the warped pixels are converted.
+	void recognize(const cv::Mat& color, const cv::Mat& cards, const std::vector<std::vector<cv::Point>>& contours, StageClock& clock,
+		DetectionResult& result, int scale = 1);
+
+	// The Output stage, the frame with the recognized cards highlighted and labeled
+	void drawOutput(const cv::Mat& color, DetectionResult& result);
+
+	// Homography of a card and the fixed-point remap tables of its index strip
+	struct CachedWarp
+	{
+		std::vector<cv::Point2f> corners;
+		cv::Mat homography;
+		cv::Mat map_xy;		// CV_16SC2 integer source positions
+		cv::Mat map_frac;	// CV_16UC1 interpolation table indices
+	};
+
+	const CachedWarp& cachedWarp(const std::vector<cv::Point2f>& corners, const std::vector<cv::Point2f>& target, DetectionResult& result);
+
+	GlyphClassifier::Match verify(GlyphClassifier& classifier, const cv::Mat& gray, const cv::Mat& homography, bool rank);
+
+	GlyphClassifier m_rank_classifier;
+	GlyphClassifier m_suit_classifier;
+	std::vector<GlyphClassifier::Match> m_rank_matches;
+	std::vector<GlyphClassifier::Match> m_suit_matches;
+	std::vector<int> m_rank_hints;
+	std::vector<int> m_suit_hints;
+	std::vector<float> m_verify_scores;
+	std::vector<float> m_verify_totals;
+	std::vector<cv::Mat> m_reference_ranks;		// Templates as the per card matcher loaded them
+	std::vector<cv::Mat> m_reference_suits;
+	uint32_t m_red_suits = 0;		// Suit templates allowed for red ink, as GlyphClassifier bits
+	uint32_t m_black_suits = 0;
+
+	// Cards of the previous frame, their labels are tried first for the card at the same place
+	struct TrackedCard
+	{
+		std::vector<cv::Point> quad;
+		int rank_label;
+		int suit_label;
+	};
+	std::vector<TrackedCard> m_tracked;
+
+	// Warps of the previous frame, and those of the current one as they are made
+	std::vector<CachedWarp> m_warp_cache;
+	std::vector<CachedWarp> m_warp_cache_next;
+	std::unordered_map<std::string, cv::Mat> m_card_img_data;
+
+	DoubleBuffer m_gray;
+	DoubleBuffer m_contours;
+	DoubleBuffer m_rect_contours;
+	DoubleBuffer m_output;
+
+	// Index strips of all cards stacked, and their boxes thresholded and dilated, see glyphBox()
+	DoubleBuffer m_index_strips;
+	DoubleBuffer m_rank_binary;
+	DoubleBuffer m_rank_dilated;
+	DoubleBuffer m_suit_binary;
+	cv::Mat m_color_strip;			// Scratch for an index strip warped from a BGR frame
+	cv::Mat m_highlight_mask;		// Scratch mask for the card highlights on the Output stage
+
+	// Front end graph and what it was compiled for
+	cv::GCompiled m_front_end;
+	cv::GMatDesc m_front_end_desc;
+	GaussianParameters m_front_end_gauss;
+	CannyParameters m_front_end_canny;
+	bool m_front_end_stages = false;
+};
+
+#endif // _CARD_DETECTOR_H_
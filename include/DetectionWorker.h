@@ -0,0 +1,106 @@
+#ifndef _DETECTION_WORKER_H_
+#define _DETECTION_WORKER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "opencv2/core.hpp"
+
+#include "CardDetector.h"
+#include "FrameSource.h"
+
+
+// Detector settings that can be changed from the UI
+struct DetectorSettings
+{
+	GaussianParameters gauss;
+	CannyParameters canny;
+};
+
+
+/*
+Latest value slot for detector settings.
+
+The settings are packed into a single 64 bit word, so posting from the UI thread and
+fetching from the detection thread never block each other and the reader can only
+ever see a complete set of values. Every field is kept in 15 bits, the top bit marks
+that something was posted at all.
+*/
+class ParameterMailbox
+{
+public:
+	void post(const DetectorSettings& settings);
+
+	// Returns true and fills settings when they differ from the ones fetched last time, single reader only
+	bool fetch(DetectorSettings& settings);
+
+private:
+	std::atomic<uint64_t> m_slot{ 0 };
+	uint64_t m_fetched = 0;
+};
+
+
+// One completed detector pass, never modified once published
+struct DetectionSnapshot
+{
+	size_t frame_id = 0;		// Increases with every published snapshot, starting at 1
+	bool live = false;			// Input came from the live source rather than the still image
+	int64_t timestamp_us = 0;	// Capture time of the live source, time since the worker started for sources without a clock
+	cv::Mat input;
+	DetectionResult result;
+	double process_ms = 0;
+};
+
+
+/*
+Runs the detector on its own thread, at whatever rate the input and the pipeline allow.
+
+Live frames are processed as they arrive. The still image is only processed again when
+the settings change or the input is switched, so an idle UI does not keep a core busy.
+Live input that fails briefly keeps its last frame, only after a second without frames
+does the still image take over. A frame the detector throws on is logged and skipped.
+Consumers pick up the most recent snapshot with latest(), which they may keep for as
+long as they like: the stage images it references are not reused by the detector
+while they are still referenced.
+*/
+class DetectionWorker
+{
+public:
+	// Called on the detection thread for every snapshot before it is published
+	using SnapshotCallback = std::function<void(const DetectionSnapshot&)>;
+
+	// live may be null when there is no live input
+	DetectionWorker(CardDetector& detector, FrameSource& still, FrameSource* live);
+	~DetectionWorker();
+
+	DetectionWorker(const DetectionWorker&) = delete;
+	DetectionWorker& operator=(const DetectionWorker&) = delete;
+
+	void start(SnapshotCallback on_snapshot = nullptr);
+	void stop();
+
+	// Most recent snapshot, null until the first frame was processed
+	std::shared_ptr<const DetectionSnapshot> latest() const;
+
+	void setLive(bool live) { m_use_live = live; }
+
+	ParameterMailbox parameters;
+
+private:
+	void run();
+
+	CardDetector& m_detector;
+	FrameSource& m_still;
+	FrameSource* m_live;
+	SnapshotCallback m_on_snapshot;
+
+	std::atomic<bool> m_running{ false };
+	std::atomic<bool> m_use_live{ false };
+	std::shared_ptr<const DetectionSnapshot> m_latest;	// Only accessed through std::atomic_load/atomic_store
+	std::thread m_thread;
+};
+
+#endif // _DETECTION_WORKER_H_
@@ -67,6 +67,8 @@ public:
 			//mY = std::min(frame.rows - scaledTitleHeight, mY);
 		}
 
+		// Window contents are only redrawn where they changed since the last frame
+		cvui::beginRetained(frame, mTitle, cv::Rect(mX, mY, mWidth, mHeight));
 		cvui::window(frame, mX, mY, mWidth, mHeight, mTitle, mFontScale);
 		if (mMinimizable && cvui::button(frame, mX + mWidth - scaledTitleHeight, mY + 1, scaledTitleHeight-1, scaledTitleHeight-1, mMinimized ? "+" : "-", mFontScale)) {
 			mMinimized = !mMinimized;
@@ -97,6 +99,7 @@ public:
 	void end() {
 		cvui::endColumn();
 		cvui::endRow();
+		cvui::endRetained();
 	}
 
 	int posX() const {
@@ -0,0 +1,46 @@
+#ifndef _FRAME_BUFFER_H_
+#define _FRAME_BUFFER_H_
+
+#include <cstddef>
+
+#include "opencv2/core.hpp"
+
+/*
+Frame sized buffers that are rendered into every frame.
+
+Stage outputs are handed out as reference counted cv::Mat headers instead of clones.
+Rendering alternates between two buffers so the frame handed out last time stays
+intact while the next one is produced, and a buffer that is still referenced by a
+consumer is replaced rather than overwritten.
+*/
+class DoubleBuffer
+{
+public:
+	// Buffer to render the next frame into, allocated only when the shape changes or the old one is still in use
+	cv::Mat& next(cv::Size size, int type)
+	{
+		m_index ^= 1;
+		cv::Mat& buffer = m_buffers[m_index];
+
+		// Consumers on other threads release their references with CV_XADD, so read the count the same way
+		bool shared = buffer.u != nullptr && CV_XADD(&buffer.u->refcount, 0) > 1;
+		if (shared || buffer.size() != size || buffer.type() != type)
+		{
+			buffer = cv::Mat(size, type);
+		}
+		return buffer;
+	}
+
+private:
+	cv::Mat m_buffers[2];
+	int m_index = 0;
+};
+
+
+// Bytes of pixel data copied while producing a frame
+inline size_t byteSize(const cv::Mat& m)
+{
+	return m.total() * m.elemSize();
+}
+
+#endif // _FRAME_BUFFER_H_
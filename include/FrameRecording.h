@@ -0,0 +1,107 @@
+#ifndef _FRAME_RECORDING_H_
+#define _FRAME_RECORDING_H_
+
+#include <cstdint>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "opencv2/core.hpp"
+#include "FrameSource.h"
+
+/*
+Uncompressed frame recording used to replay captured sessions bit for bit.
+
+Layout, little endian, every block starts on a 64 byte boundary:
+	RecordingFileHeader
+	{ RecordingFrameHeader, pixel rows packed without padding, zero fill to 64 bytes } * N
+
+A recording cut short by a crash is still readable up to the last complete frame.
+*/
+
+const size_t RECORDING_ALIGNMENT = 64;
+
+struct RecordingFileHeader
+{
+	char magic[8];				// "CARDREC\0"
+	uint32_t version;
+	uint8_t reserved[52];
+};
+
+struct RecordingFrameHeader
+{
+	int64_t timestamp_us;		// Capture time relative to the start of the recording
+	int32_t rows;
+	int32_t cols;
+	int32_t type;				// OpenCV matrix type, CV_8UC1 or CV_8UC3
+	uint32_t reserved0;
+	uint64_t size;				// Payload size in bytes, excluding the alignment fill
+	uint8_t reserved[32];
+};
+
+static_assert(sizeof(RecordingFileHeader) == RECORDING_ALIGNMENT, "Recording header must fill one block");
+static_assert(sizeof(RecordingFrameHeader) == RECORDING_ALIGNMENT, "Frame header must fill one block");
+
+
+// Appends frames to a recording file as they are captured
+class FrameRecorder
+{
+public:
+	explicit FrameRecorder(const std::string& path);
+
+	bool isOpened() const { return m_file.is_open() && m_file.good(); }
+
+	// Stamp the frame with the time elapsed since the recorder was created
+	void write(const cv::Mat& frame);
+	void write(const cv::Mat& frame, int64_t timestamp_us);
+
+	size_t frameCount() const { return m_frame_count; }
+
+private:
+	std::ofstream m_file;
+	std::chrono::steady_clock::time_point m_start;
+	size_t m_frame_count = 0;
+};
+
+
+// Memory maps a recording and hands out frames as views into the mapping, no pixel is copied
+class ReplaySource : public FrameSource
+{
+public:
+	// When loop is set the recording restarts instead of ending the stream
+	ReplaySource(const std::string& path, bool loop);
+	~ReplaySource() override;
+
+	ReplaySource(const ReplaySource&) = delete;
+	ReplaySource& operator=(const ReplaySource&) = delete;
+
+	// BGR frames alias the mapping and stay valid for the lifetime of the source, the mapping
+	// is private, writing to it never reaches the file. Gray frames are converted to BGR into
+	// a new buffer on every read.
+	bool read(cv::Mat& frame) override;
+	bool isOpened() const override { return !m_frames.empty(); }
+	double fps() const override;
+
+	size_t frameCount() const { return m_frames.size(); }
+
+	// Recorded capture time of the frame returned by the last read
+	int64_t timestamp() const override { return m_timestamp; }
+
+private:
+	struct Frame
+	{
+		RecordingFrameHeader header;
+		uint8_t* data;
+	};
+
+	void* m_mapping = nullptr;
+	size_t m_mapping_size = 0;
+	std::vector<uint8_t> m_buffer;		// Backing store where memory mapping is unavailable
+	std::vector<Frame> m_frames;
+	size_t m_next = 0;
+	bool m_loop = false;
+	int64_t m_timestamp = 0;
+};
+
+#endif // _FRAME_RECORDING_H_
@@ -0,0 +1,69 @@
+#ifndef _FRAME_SOURCE_H_
+#define _FRAME_SOURCE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+
+
+/*
+Common interface for everything the detector can pull BGR frames from.
+*/
+class FrameSource
+{
+public:
+	virtual ~FrameSource() = default;
+
+	// Fetch the next frame, returns false once the source is exhausted
+	virtual bool read(cv::Mat& frame) = 0;
+
+	virtual bool isOpened() const = 0;
+
+	// Nominal frame rate of the source, 0 when it has none
+	virtual double fps() const { return 0; }
+
+	// Capture time in microseconds of the frame returned by the last read, -1 when the
+	// source keeps no clock and callers have to stamp frames themselves
+	virtual int64_t timestamp() const { return -1; }
+};
+
+
+// Hands out the same still image on every read
+class ImageSource : public FrameSource
+{
+public:
+	explicit ImageSource(const std::string& path);
+
+	bool read(cv::Mat& frame) override;
+	bool isOpened() const override { return !m_image.empty(); }
+
+private:
+	cv::Mat m_image;
+};
+
+
+// Camera or video file opened through cv::VideoCapture
+class CaptureSource : public FrameSource
+{
+public:
+	explicit CaptureSource(int camera_index);
+
+	// When loop is set the file is rewound instead of ending the stream
+	CaptureSource(const std::string& path, bool loop);
+
+	bool read(cv::Mat& frame) override;
+	bool isOpened() const override { return m_capture.isOpened(); }
+	double fps() const override;
+
+	// Position in the file, cameras have no clock that is comparable across backends
+	int64_t timestamp() const override;
+
+private:
+	cv::VideoCapture m_capture;
+	bool m_is_file = false;
+	bool m_loop = false;
+};
+
+#endif // _FRAME_SOURCE_H_
@@ -0,0 +1,125 @@
+#ifndef _GLYPH_CLASSIFIER_H_
+#define _GLYPH_CLASSIFIER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+
+/*
+Nearest template classifier for the rank and suit glyphs of a whole frame at once.
+
+Every glyph is scaled to the template size and stored as one row of an N x D matrix,
+the templates form a T x D matrix. The sums of squared differences of all pairs then
+come out of a single matrix product,
+	||g - t||^2 = ||g||^2 + ||t||^2 - 2 g.t
+so scenes with many cards are classified at the speed of cv::gemm rather than with a
+resize, absdiff and sum per card and template. Glyphs and templates are dark on light,
+and both are thresholded again once scaled to the template size, so the squared
+difference of pixels scaled to [0, 1] equals the number of pixels that differ.
+
+Glyphs that come with a hint, usually the answer for the same card in the previous
+frame, are scored one template at a time instead: the hinted template first, then the
+others a few rows at a time, abandoning each as soon as its partial sum can no longer
+beat the best one so far. A correct hint resolves the glyph after one full comparison.
+
+Every match carries its margin to the runner-up. A margin of confidentMargin() or more
+counts as fully confident, so the bounded matcher only abandons a template once it
+trails the best by that much and the margin it reports is exact below that. Templates
+ruled out by color cannot win but still count for the margin, a glyph that one of them
+fits about as well is not a confident match. The margin to a template can never exceed
+the distance between it and the best one, so the confident margin is derived from the
+two templates that are closest to each other.
+*/
+class GlyphClassifier
+{
+public:
+	struct Match
+	{
+		int label = -1;		// Index of the best template
+		int score = 0;		// Pixels that differ from the best template, lower is better
+		int margin = 0;		// Runner-up score minus score over all templates, capped at confidentMargin()
+		float confidence = 0;	// margin / confidentMargin(), from 0 for a tie to 1
+	};
+
+	// Templates are scaled to glyph_size, every glyph is compared at that size
+	void setTemplates(const std::vector<std::pair<std::string, cv::Mat>>& templates, cv::Size glyph_size);
+
+	const std::string& name(int label) const { return m_names[label]; }
+	size_t templateCount() const { return m_names.size(); }
+
+	// Start a new batch, keeps the allocations of the previous one
+	void clear() { m_count = 0; }
+
+	static const uint32_t ALL_TEMPLATES = 0xFFFFFFFF;
+
+	// Append a single channel glyph to the batch and return its row.
+	// allowed has a bit set for every template the glyph may match, at most 32 templates.
+	size_t add(const cv::Mat& glyph, uint32_t allowed = ALL_TEMPLATES);
+
+	// Work done by the last classify()
+	struct Stats
+	{
+		size_t batched = 0;		// Glyphs matched by the matrix product
+		size_t bounded = 0;		// Glyphs matched one template at a time
+		size_t scored = 0;		// Templates the bounded matcher compared in full
+		size_t abandoned = 0;	// Templates the bounded matcher gave up on once they could not win
+		size_t pruned = 0;		// Templates ruled out by color before any pixel was compared
+
+		Stats& operator+=(const Stats& other)
+		{
+			batched += other.batched;
+			bounded += other.bounded;
+			scored += other.scored;
+			abandoned += other.abandoned;
+			pruned += other.pruned;
+			return *this;
+		}
+	};
+
+	// Best template for every glyph of the batch, in the order they were added.
+	// hints holds the most likely label of every glyph or -1, it may be empty.
+	void classify(std::vector<Match>& matches, const std::vector<int>& hints = std::vector<int>());
+
+	const Stats& stats() const { return m_stats; }
+
+	// Margin between best and runner-up that leaves no doubt, half the pixels that set the
+	// two most similar templates apart (Eight and Three, Clubs and Spades), which every
+	// glyph can reach against every template
+	int confidentMargin() const { return m_confident_margin; }
+
+	// Squared difference of a single glyph to every template, without any pruning or early exit
+	void scoreAll(const cv::Mat& glyph, std::vector<float>& scores);
+
+	// Best of the given per template scores, with margin and confidence
+	Match bestOf(const std::vector<float>& scores) const;
+
+private:
+	// Templates worth comparing with a glyph in the order to compare them
+	void candidates(size_t glyph, int hint, std::vector<int>& order);
+	Match matchBounded(const float* glyph, const std::vector<int>& order);
+
+	// Squared difference to template t, stops early and returns a lower bound once it reaches bound
+	float boundedScore(const float* glyph, int t, float bound) const;
+
+	std::vector<std::string> m_names;
+	cv::Size m_glyph_size;
+	cv::Mat m_templates;		// T x D, CV_32F
+	cv::Mat m_template_norms;	// 1 x T, squared norms of the rows of m_templates
+	cv::Mat m_glyphs;			// Capacity x D, CV_32F, the first m_count rows are in use
+	cv::Mat m_scaled;			// Scratch for a glyph at template size
+	cv::Mat m_single;			// Scratch for the float row of a single glyph
+	cv::Mat m_dots;				// N x T
+	cv::Mat m_unhinted;			// Rows of the glyphs without a hint, gathered for the matrix product
+	std::vector<size_t> m_unhinted_rows;
+	int m_confident_margin = 1;
+	std::vector<uint32_t> m_allowed;			// Templates the glyphs in the batch may match
+	std::vector<std::vector<int>> m_orders;		// Candidates of the glyphs in the batch
+	size_t m_count = 0;
+	Stats m_stats;
+};
+
+#endif // _GLYPH_CLASSIFIER_H_
@@ -0,0 +1,67 @@
+#ifndef _GROUND_TRUTH_H_
+#define _GROUND_TRUTH_H_
+
+#include <string>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+#include "CardDetector.h"
+
+/*
+Hand labeled images for measuring recognition accuracy.
+
+Annotation files hold one card per line, blank lines and lines starting with # are ignored:
+	<image> <rank> <suit> [x0 y0 x1 y1 x2 y2 x3 y3]
+Image paths are relative to the annotation file. Rank and suit use the template names
+(Ace, Two, ..., King and Hearts, Clubs, Spades, Diamonds). The optional quad is the card
+outline in image pixels, when it is given a detection only counts for this card if its
+midpoint lies inside.
+*/
+
+struct LabeledCard
+{
+	std::string rank;
+	std::string suit;
+	std::vector<cv::Point> quad;	// Empty when the outline was not labeled
+};
+
+
+struct LabeledImage
+{
+	std::string path;
+	cv::Mat image;
+	std::vector<LabeledCard> cards;
+};
+
+
+// Recognition accuracy of one or more detector passes
+struct Accuracy
+{
+	size_t expected = 0;	// Labeled cards
+	size_t detected = 0;	// Cards reported by the detector
+	size_t correct = 0;		// Labeled cards matched by a detection with the right rank and suit
+
+	// Correct cards over labeled plus spurious ones, so missing and made up cards both count
+	double score() const
+	{
+		size_t spurious = detected > correct ? detected - correct : 0;
+		return expected + spurious > 0 ? double(correct) / (expected + spurious) : 1.0;
+	}
+
+	Accuracy& operator+=(const Accuracy& other)
+	{
+		expected += other.expected;
+		detected += other.detected;
+		correct += other.correct;
+		return *this;
+	}
+};
+
+
+// Loads the annotations and their images, images that cannot be read are reported and skipped
+std::vector<LabeledImage> loadGroundTruth(const std::string& path);
+
+Accuracy scoreDetection(const LabeledImage& labels, const DetectionResult& result);
+
+#endif // _GROUND_TRUTH_H_
@@ -0,0 +1,48 @@
+#ifndef _PARAMETER_TUNER_H_
+#define _PARAMETER_TUNER_H_
+
+#include <string>
+#include <vector>
+
+#include "DetectionWorker.h"
+#include "GroundTruth.h"
+
+
+// Values tried for every detector setting, each range includes both of its ends
+struct TuningGrid
+{
+	int kernel_min = 1, kernel_max = 9, kernel_step = 2;		// Gaussian kernels have to be odd
+	int sigma_min = 0, sigma_max = 10, sigma_step = 2;
+	int threshold_min = 0, threshold_max = 255, threshold_step = 32;
+};
+
+
+// How one combination of settings did over the labeled images
+struct TuningResult
+{
+	DetectorSettings settings;
+	Accuracy accuracy;
+	double latency_ms = 0;		// Mean detector time per image
+};
+
+
+/*
+Runs the detector with every combination of the grid over the labeled images.
+
+The combinations are spread over `threads` workers, each with its own detector, so the
+latencies are measured under the same load for every combination and compare fairly
+with each other, though not with a detector that has the machine to itself.
+*/
+std::vector<TuningResult> sweepSettings(const std::vector<LabeledImage>& images, const TuningGrid& grid, int threads);
+
+// Results no other result beats in both accuracy and latency, fastest first
+std::vector<TuningResult> paretoFront(const std::vector<TuningResult>& results);
+
+// Most accurate point of the front within budget_ms, the fastest one if none is, budget_ms <= 0 means no budget
+const TuningResult& chooseSettings(const std::vector<TuningResult>& front, double budget_ms);
+
+// Detector settings file, YAML as written by cv::FileStorage
+bool saveDetectorSettings(const std::string& path, const DetectorSettings& settings);
+bool loadDetectorSettings(const std::string& path, DetectorSettings& settings);
+
+#endif // _PARAMETER_TUNER_H_
@@ -0,0 +1,37 @@
+#ifndef _PREVIEW_CACHE_H_
+#define _PREVIEW_CACHE_H_
+
+#include <cstddef>
+#include <string>
+
+#include "opencv2/core.hpp"
+
+
+/*
+Display sized BGR copy of a pipeline stage.
+
+Stage images come at source resolution and grayscale stages have to be converted
+before cvui can show them. The preview is area downscaled to fit the window first
+and only rebuilt when the stage, the frame or the available size change.
+*/
+class PreviewCache
+{
+public:
+	// Preview of image that fits into max_size, image is only read when the key changed
+	const cv::Mat& get(const std::string& stage, size_t frame_id, const cv::Mat& image, cv::Size max_size);
+
+	// Changes every time the preview is rebuilt, never 0
+	size_t revision() const { return m_revision; }
+
+private:
+	std::string m_stage;
+	size_t m_frame_id = 0;
+	cv::Size m_max_size;
+	size_t m_revision = 0;
+
+	cv::Mat m_scaled;
+	cv::Mat m_converted;
+	cv::Mat m_preview;		// Refers to one of the buffers above or to the stage image itself
+};
+
+#endif // _PREVIEW_CACHE_H_
@@ -0,0 +1,135 @@
+#ifndef _RECOGNITION_SERVER_H_
+#define _RECOGNITION_SERVER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.h"
+#include "CardDetector.h"
+#include "ResultsStream.h"
+
+/*
+Wire protocol of the recognition daemon, little endian, over a Unix domain stream socket.
+
+A client sends any number of requests on one connection and gets one response per
+request, in order:
+	RecognitionRequest, payload of `size` bytes
+	RecognitionResponse, payload of `size` bytes
+
+The request payload is either an encoded image (anything cv::imdecode reads) or the
+raw pixels of a frame described by rows/cols/type, rows packed without padding.
+The response payload is `card_count` CardRecords or a JSON document, as requested.
+When the request queue is full the request is answered right away with STATUS_BUSY
+and an empty payload, the client is expected to back off and retry.
+*/
+
+const char RECOGNITION_REQUEST_MAGIC[4] = { 'C', 'R', 'Q', '1' };
+const char RECOGNITION_RESPONSE_MAGIC[4] = { 'C', 'R', 'S', '2' };
+
+enum RequestKind : uint32_t
+{
+	REQUEST_ENCODED = 1,
+	REQUEST_RAW = 2
+};
+
+enum ResultFormat : uint32_t
+{
+	RESULT_BINARY = 1,
+	RESULT_JSON = 2
+};
+
+enum ResponseStatus : uint32_t
+{
+	STATUS_OK = 0,
+	STATUS_BUSY = 1,
+	STATUS_BAD_REQUEST = 2,
+	STATUS_DECODE_FAILED = 3,
+	STATUS_INTERNAL_ERROR = 4		// The request could not be processed, e.g. out of memory
+};
+
+struct RecognitionRequest
+{
+	char magic[4];			// "CRQ1"
+	uint32_t kind;			// RequestKind
+	uint32_t format;		// ResultFormat
+	int32_t rows;			// Raw frames only
+	int32_t cols;
+	int32_t type;			// OpenCV matrix type, CV_8UC1 or CV_8UC3
+	uint64_t size;			// Payload bytes following the header
+};
+
+struct RecognitionResponse
+{
+	char magic[4];			// "CRS2", CardRecords with confidences
+	uint32_t status;		// ResponseStatus
+	uint32_t format;		// ResultFormat of the payload
+	uint32_t card_count;
+	uint64_t size;			// Payload bytes following the header
+	uint64_t process_us;	// Time spent in the detector
+};
+
+
+struct ServerOptions
+{
+	std::string socket_path;
+	int workers = 2;				// Detector threads, each with its own templates and buffers
+	size_t queue_size = 8;			// Requests waiting for a worker before new ones are turned away
+	size_t max_connections = 64;
+	uint64_t max_payload = 256ull << 20;
+	GaussianParameters gauss;
+	CannyParameters canny;
+};
+
+
+/*
+Long lived recognition service, so other processes pay the template loading and
+graph setup once instead of per request.
+
+Every connection is read on its own thread, which queues the request for the worker
+pool and writes back the response once a worker finished it.
+*/
+class RecognitionServer
+{
+public:
+	explicit RecognitionServer(const ServerOptions& options);
+	~RecognitionServer();
+
+	// Serves requests until stop() is called, false when the socket cannot be opened.
+	// A stop() that arrives before or while run() starts up still ends it.
+	bool run();
+
+	// Only sets a flag, so it may be called from a signal handler
+	void stop() { m_stop_requested = true; }
+
+private:
+	struct Job
+	{
+		RecognitionRequest request;
+		std::vector<uchar> payload;
+		std::promise<std::vector<uchar>> response;
+	};
+
+	void work(CardDetector& detector);
+	void serveConnection(int fd);
+	std::vector<uchar> handle(CardDetector& detector, Job& job);
+
+	ServerOptions m_options;
+	std::atomic<bool> m_stop_requested{ false };
+	BoundedQueue<std::shared_ptr<Job>> m_queue;
+
+	std::mutex m_connections_mutex;
+	std::set<int> m_connections;
+	std::atomic<size_t> m_connection_count{ 0 };
+};
+
+// Result of a detector pass in the daemon's JSON response encoding
+std::string encodeResultJson(const DetectionResult& result);
+
+#endif // _RECOGNITION_SERVER_H_
@@ -0,0 +1,46 @@
+#ifndef _REDUCED_IMAGE_H_
+#define _REDUCED_IMAGE_H_
+
+#include <string>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+
+/*
+Still image decoded in grayscale at a half, quarter or eighth of its resolution for finding
+the cards, with the full resolution color image decoded on first use only.
+
+JPEG decoders produce the reduced image straight from the DCT coefficients and skip the
+color conversion, which costs a fraction of a full decode. Other formats are decoded whole
+and scaled down by OpenCV. The file is read once, on construction, and its encoded bytes are
+kept until the full image is decoded from them, so that decode does no I/O.
+*/
+class ReducedImage
+{
+public:
+	// reduction is 2, 4 or 8, anything else decodes at full resolution right away
+	ReducedImage(const std::string& path, int reduction);
+
+	bool empty() const { return m_reduced.empty(); }
+
+	// Grayscale, scale() times smaller than the image in both directions
+	const cv::Mat& reduced() const { return m_reduced; }
+	int scale() const { return m_scale; }
+
+	// BGR at full resolution, decoded by the first call
+	const cv::Mat& full();
+	bool fullDecoded() const { return !m_full.empty(); }
+
+	// Time full() spent decoding, 0 when it was not needed or decoded on construction
+	double fullDecodeMs() const { return m_full_decode_ms; }
+
+private:
+	std::vector<uchar> m_encoded;
+	double m_full_decode_ms = 0;
+	int m_scale = 1;
+	cv::Mat m_reduced;
+	cv::Mat m_full;
+};
+
+#endif // _REDUCED_IMAGE_H_
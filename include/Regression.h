@@ -0,0 +1,50 @@
+#ifndef _REGRESSION_H_
+#define _REGRESSION_H_
+
+#include <string>
+#include <vector>
+
+#include "CardDetector.h"
+#include "GroundTruth.h"
+
+
+// Accuracy and throughput of the detector over a labeled image set
+struct RegressionReport
+{
+	Accuracy accuracy;
+	std::vector<Accuracy> per_image;	// In the order of the labeled images
+	double images_per_sec = 0;
+	size_t disagreements = 0;		// Glyphs the batched classifier and the per card reference matcher label differently
+};
+
+
+// Reference numbers a run is compared against, with the losses it may show
+struct RegressionBaseline
+{
+	double accuracy = 0;
+	double images_per_sec = 0;
+	double accuracy_tolerance = 0;		// Absolute drop in Accuracy::score() that still passes
+	double throughput_tolerance = 0.1;	// Relative drop in images per second that still passes
+	bool check_throughput = true;		// Off for baselines shared between machines, which only gate accuracy
+	bool recorded = false;				// The numbers were measured by --update-baseline, not left out of the file
+};
+
+
+/*
+Runs every labeled image through the detector `passes` times. Accuracy is taken from
+the first pass, throughput over all of them with a warm detector, so the number does
+not depend on template loading or first touch allocations. The first pass also cross
+checks the batched classifier against the per card matcher it replaced.
+*/
+RegressionReport runRegression(CardDetector& detector, const std::vector<LabeledImage>& images, int passes);
+
+// Returns false and reports the reason for every number that regressed beyond its tolerance,
+// and for any glyph the two matchers disagree on
+bool checkRegression(const RegressionReport& report, const RegressionBaseline& baseline);
+
+// Baseline file, YAML as written by cv::FileStorage. A file holding only tolerances loads
+// as a baseline that is not recorded yet.
+bool saveRegressionBaseline(const std::string& path, const RegressionBaseline& baseline);
+bool loadRegressionBaseline(const std::string& path, RegressionBaseline& baseline);
+
+#endif // _REGRESSION_H_
@@ -0,0 +1,114 @@
+#ifndef _RESULTS_STREAM_H_
+#define _RESULTS_STREAM_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CardDetector.h"
+
+/*
+Machine readable recognition results.
+
+JSON Lines: one object per frame
+	{"frame":1,"timestamp_us":0,"timings_ms":{"Capture":0.1,...},"cards":[{"rank":"Ace",...}]}
+
+Binary, little endian, the file header and frame records fill a 64 byte block each,
+card records are packed after their frame record:
+	ResultsFileHeader
+	{ ResultsFrameRecord, CardRecord * card_count } * N
+Version 2 added the match confidences to CardRecord.
+*/
+
+// One recognized card in the binary encodings
+struct CardRecord
+{
+	int32_t quad[8];		// x, y of the four outline corners
+	float midpoint[2];
+	int32_t rank_score;
+	int32_t suit_score;
+	char rank[16];			// Zero terminated
+	char suit[16];
+	float rank_confidence;	// 0 for a tie with another template to 1 for no doubt
+	float suit_confidence;
+};
+
+struct ResultsFileHeader
+{
+	char magic[8];			// "CARDRES\0"
+	uint32_t version;
+	uint32_t stage_count;	// Entries of ResultsFrameRecord::stage_ms, in the order of Stage
+	uint8_t reserved[48];
+};
+
+struct ResultsFrameRecord
+{
+	uint64_t frame_id;
+	int64_t timestamp_us;
+	uint32_t card_count;	// CardRecords following this record
+	uint32_t reserved0;
+	float stage_ms[STAGE_COUNT];
+	uint8_t reserved[64 - 24 - 4 * STAGE_COUNT];
+};
+
+static_assert(sizeof(ResultsFileHeader) == 64, "file header must fill one block");
+static_assert(sizeof(ResultsFrameRecord) == 64, "frame record must fill one block");
+static_assert(sizeof(CardRecord) == 88, "card records are read by other programs");
+
+std::vector<uchar> encodeCardRecords(const DetectionResult& result);
+
+// The "cards" array of the JSON encodings
+void writeCardsJson(std::ostream& json, const DetectionResult& result);
+
+// text as a quoted JSON string, quotes, backslashes and control characters escaped
+void writeJsonString(std::ostream& json, const std::string& text);
+
+
+/*
+Writes one record per processed frame without holding up the caller.
+
+Records are serialized on the calling thread into a pending buffer and a background
+thread writes them to disk. When the disk falls so far behind that the pending buffer
+exceeds its limit, records are dropped and counted instead of blocking the frame loop.
+*/
+class ResultsWriter
+{
+public:
+	enum Format
+	{
+		FORMAT_JSONL,
+		FORMAT_BINARY
+	};
+
+	ResultsWriter(const std::string& path, Format format, size_t max_pending = 16 << 20);
+	~ResultsWriter();
+
+	bool isOpened() const { return m_file.is_open(); }
+
+	void write(uint64_t frame_id, int64_t timestamp_us, const DetectionResult& result);
+
+	// Records lost because the pending buffer was full
+	size_t dropped() const { return m_dropped; }
+
+private:
+	void run();
+
+	std::ofstream m_file;
+	Format m_format;
+	size_t m_max_pending;
+
+	std::mutex m_mutex;
+	std::condition_variable m_ready;
+	std::string m_pending;
+	bool m_stop = false;
+	std::atomic<size_t> m_dropped{ 0 };
+	std::thread m_thread;
+};
+
+#endif // _RESULTS_STREAM_H_
@@ -0,0 +1,40 @@
+#ifndef _SCALING_BENCHMARK_H_
+#define _SCALING_BENCHMARK_H_
+
+#include <string>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+#include "CardDetector.h"
+#include "GroundTruth.h"
+#include "SceneGenerator.h"
+#include "StageTimings.h"
+
+
+// Detector cost for one scene size and card count
+struct BenchmarkPoint
+{
+	cv::Size size;
+	int card_count = 0;
+	StageTimings mean;			// Mean per stage over the timed passes
+	double total_ms = 0;		// Mean time of a whole detector pass
+	Accuracy accuracy;			// Of the first pass
+	GlyphClassifier::Stats rank_stats;	// Of the first pass, how often color pruned and the matcher exited early
+	GlyphClassifier::Stats suit_stats;
+};
+
+
+/*
+Runs the detector over a synthetic scene for every combination of size and card count.
+Each scene is processed once untimed, then `passes` times for the timings.
+*/
+std::vector<BenchmarkPoint> runScalingBenchmark(CardDetector& detector, SceneGenerator& generator,
+	const std::vector<cv::Size>& sizes, const std::vector<int>& card_counts, int passes);
+
+bool writeBenchmarkCsv(const std::string& path, const std::vector<BenchmarkPoint>& points);
+
+// One chart per scene size with a latency curve per stage over the card count
+cv::Mat plotBenchmark(const std::vector<BenchmarkPoint>& points);
+
+#endif // _SCALING_BENCHMARK_H_
@@ -0,0 +1,52 @@
+#ifndef _SCENE_GENERATOR_H_
+#define _SCENE_GENERATOR_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+#include "GroundTruth.h"
+
+
+struct SceneOptions
+{
+	cv::Size size = { 1280, 720 };
+	int card_count = 10;
+	double max_rotation = 25;		// Degrees either way
+	double perspective = 0.08;		// Corner jitter relative to the card width
+	double occlusion = 0.3;			// Chance of an object lying on a card, away from its index
+	double lighting = 0.4;			// Brightness falloff across the scene, 0 for even lighting
+	double noise = 6;				// Standard deviation of the sensor noise in gray levels
+	uint64_t seed = 1;
+};
+
+
+/*
+Composes synthetic photos of cards with known ground truth.
+
+Card faces are drawn from the rank and suit artwork the detector matches against, with
+the index in the top left corner where the detector looks for it. Cards are laid out on
+a grid so their outlines do not touch, each with its own rotation and perspective, then
+the whole scene gets uneven lighting and noise. The same options and seed always give
+the same scene.
+*/
+class SceneGenerator
+{
+public:
+	explicit SceneGenerator(const std::string& template_dir = "images/");
+
+	// The returned labels carry the outline of every card in scene pixels
+	LabeledImage generate(const SceneOptions& options);
+
+private:
+	cv::Mat renderFace(size_t rank, size_t suit);
+
+	std::vector<std::pair<std::string, cv::Mat>> m_ranks;
+	std::vector<std::pair<std::string, cv::Mat>> m_suits;
+	std::vector<cv::Mat> m_faces;		// Rendered lazily, indexed by rank * suit count + suit
+	cv::Mat m_face_mask;
+};
+
+#endif // _SCENE_GENERATOR_H_
@@ -0,0 +1,126 @@
+#ifndef _SHM_RING_H_
+#define _SHM_RING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "opencv2/core.hpp"
+#include "FrameSource.h"
+
+/*
+Frame ring in POSIX shared memory, for capture processes running on the same host.
+
+Layout, every block starts on a 64 byte boundary:
+	ShmRingHeader
+	{ ShmSlotHeader, slot_size payload bytes } * slot_count
+
+The producer fills the slots in sequence order. A slot goes FREE -> WRITING -> READY,
+then the consumer takes it (READING) and hands it out as a cv::Mat that points straight
+into the mapping. The slot only becomes FREE again when the last cv::Mat referencing it
+is released, so a consumer that falls behind makes the producer wait or drop frames
+rather than having frames overwritten while they are processed. Waiting uses futexes on
+Linux and short sleeps on other POSIX systems.
+
+There is a single consumer. Slots left READING by a consumer that died are taken back
+by the producer once it finds the consumer's process gone, and by the next consumer
+when it attaches. Slot descriptors are checked against the slot size and the frame
+types the detector takes before any pixel is read.
+*/
+
+const size_t SHM_RING_ALIGNMENT = 64;
+
+enum ShmSlotState : uint32_t
+{
+	SLOT_FREE = 0,
+	SLOT_WRITING = 1,
+	SLOT_READY = 2,
+	SLOT_READING = 3
+};
+
+struct ShmRingHeader
+{
+	char magic[8];							// "CARDSHM\0"
+	uint32_t version;
+	uint32_t slot_count;
+	uint64_t slot_size;						// Payload capacity of every slot
+	std::atomic<uint64_t> write_sequence;	// Sequence number of the next frame the producer writes
+	std::atomic<uint32_t> published;		// Bumped for every published frame, the consumer waits on it
+	std::atomic<int32_t> consumer_pid;		// Process of the consumer attached last, 0 for none
+	uint8_t reserved[24];
+};
+
+struct ShmSlotHeader
+{
+	std::atomic<uint32_t> state;			// ShmSlotState, the producer waits on it
+	uint32_t reserved0;
+	uint64_t sequence;
+	int64_t timestamp_us;					// Capture time as given by the producer
+	int32_t rows;
+	int32_t cols;
+	int32_t type;							// OpenCV matrix type
+	uint32_t reserved1;
+	uint64_t size;							// Payload bytes, rows packed without padding
+	uint8_t reserved[16];
+};
+
+static_assert(sizeof(ShmRingHeader) == SHM_RING_ALIGNMENT, "ring header must fill one block");
+static_assert(sizeof(ShmSlotHeader) == SHM_RING_ALIGNMENT, "slot header must fill one block");
+
+
+// Producer side, creates the ring and copies frames into it
+class ShmRingWriter
+{
+public:
+	// Slots must hold the largest frame, at least three are needed for a consumer with a UI
+	ShmRingWriter(const std::string& name, uint32_t slot_count, size_t slot_size);
+	~ShmRingWriter();
+
+	bool isOpened() const { return m_base != nullptr; }
+
+	// False when the frame does not fit a slot or no slot became free within timeout_ms
+	bool write(const cv::Mat& frame, int64_t timestamp_us, int timeout_ms = 100);
+
+private:
+	// Frees the slots a consumer that no longer runs left READING
+	bool reclaimDeadConsumer();
+
+	std::string m_name;
+	uint8_t* m_base = nullptr;
+	size_t m_size = 0;
+	uint64_t m_sequence = 0;
+};
+
+
+// Consumer side, hands out the frames of an existing ring without copying them
+class ShmRingSource : public FrameSource
+{
+public:
+	// read() gives up after timeout_ms without a new frame
+	explicit ShmRingSource(const std::string& name, int timeout_ms = 1000);
+	~ShmRingSource() override;
+
+	// BGR frames refer to the shared slot, which stays reserved until they are released,
+	// the source has to outlive them. Gray frames are converted to BGR and the slot is
+	// released right away. Slots with an invalid descriptor are released and skipped.
+	bool read(cv::Mat& frame) override;
+	bool isOpened() const override { return m_base != nullptr; }
+
+	// Producer timestamp of the frame returned by the last read()
+	int64_t timestamp() const override { return m_timestamp; }
+
+private:
+	class SlotAllocator;
+
+	std::unique_ptr<SlotAllocator> m_allocator;
+	uint8_t* m_base = nullptr;
+	size_t m_size = 0;
+	uint32_t m_slot_count = 0;		// As validated on open, the shared header is not trusted afterwards
+	uint64_t m_slot_size = 0;
+	int m_timeout_ms;
+	uint64_t m_sequence = 0;
+	int64_t m_timestamp = 0;
+};
+
+#endif // _SHM_RING_H_
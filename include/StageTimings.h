@@ -0,0 +1,95 @@
+#ifndef _STAGE_TIMINGS_H_
+#define _STAGE_TIMINGS_H_
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+
+// Pipeline stages that are timed separately
+enum Stage
+{
+	STAGE_CAPTURE,
+	STAGE_FRONT_END,		// Gray conversion and the G-API blur/equalize/Canny/contour graph
+	STAGE_QUAD_FILTER,
+	STAGE_WARP,
+	STAGE_RANK_MATCH,
+	STAGE_SUIT_MATCH,
+	STAGE_OVERLAY,
+	STAGE_UI,
+	STAGE_COUNT
+};
+
+const char* const STAGE_NAMES[STAGE_COUNT] = {
+	"Capture",
+	"Front End",
+	"Quad Filter",
+	"Warp",
+	"Rank Match",
+	"Suit Match",
+	"Overlay",
+	"UI"
+};
+
+
+// Milliseconds spent in every stage for one frame
+struct StageTimings
+{
+	double ms[STAGE_COUNT] = {};
+};
+
+
+// Stopwatch for consecutive stages
+class StageClock
+{
+public:
+	StageClock() : m_last(std::chrono::steady_clock::now()) {}
+
+	// Milliseconds since construction or the previous lap
+	double lap()
+	{
+		auto now = std::chrono::steady_clock::now();
+		double ms = std::chrono::duration_cast<std::chrono::microseconds>(now - m_last).count() / 1000.0;
+		m_last = now;
+		return ms;
+	}
+
+private:
+	std::chrono::steady_clock::time_point m_last;
+};
+
+
+/*
+Rolling window of the most recent durations of every stage.
+
+Each stage keeps a fixed size ring buffer, so recording a sample never allocates.
+Percentiles are taken over the whole window.
+*/
+class LatencyHistory
+{
+public:
+	explicit LatencyHistory(size_t capacity = 120);
+
+	void add(Stage stage, double ms);
+
+	// Samples from oldest to newest, in the form cvui::sparkline expects
+	std::vector<double>& samples(Stage stage);
+
+	// p in [0, 100], 0 when there are no samples yet
+	double percentile(Stage stage, double p);
+
+private:
+	struct Series
+	{
+		std::vector<double> ring;
+		size_t next = 0;
+		size_t count = 0;
+		bool ordered_valid = false;
+		std::vector<double> ordered;
+		std::vector<double> scratch;
+	};
+
+	Series m_series[STAGE_COUNT];
+};
+
+#endif // _STAGE_TIMINGS_H_
@@ -61,6 +61,8 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <algorithm>
 #include <stdarg.h>
 
 #include <opencv2/imgproc/imgproc.hpp>
@@ -194,6 +196,9 @@ void context(const cv::String& theWindowName);
  In general, it is easier to call `cvui::imshow()` alone instead of calling
  `cvui::update()' immediately followed by `cv::imshow()`.
 
+ When retained areas are in use (see `beginRetained()`), regions uncovered during the frame are recomposited
+ first, and the frame is not pushed to the window at all when nothing in it changed.
+
  \param theWindowName name of the window that will be shown.
  \param theFrame image, i.e. `cv::Mat`, to be shown in the window.
 
@@ -846,6 +851,20 @@ bool button(cv::Mat& theIdle, cv::Mat& theOver, cv::Mat& theDown);
 */
 void image(cv::Mat& theImage);
 
+/**
+ Display an image (cv::Mat) within a `begin*()` and `end*()` block, telling cvui when its pixels change.
+ Inside a retained area (see `beginRetained()`) the image is only copied into the frame again when the
+ revision, size or position changes. Images displayed without a revision are copied on every frame.
+
+ IMPORTANT: this function can only be used within a `begin*()/end*()` block, otherwise it does nothing.
+
+ \param theImage image to be rendered in the specified destination.
+ \param theRevision value that changes whenever the content of the image changes. `0` means unknown.
+
+ \sa beginRetained()
+*/
+void image(cv::Mat& theImage, size_t theRevision);
+
 /**
  Display a checkbox within a `begin*()` and `end*()` block. You can use the state parameter
  to monitor if the checkbox is checked or not.
@@ -1062,6 +1081,77 @@ void sparkline(std::vector<double>& theValues, int theWidth, int theHeight, unsi
 */
 void update(const cv::String& theWindowName = "");
 
+/**
+ Fill the frame with a background color when it needs to be. Call this at the start of every frame instead of
+ clearing the frame yourself. The frame is used as a persistent back buffer by retained areas, see `beginRetained()`,
+ so it is only filled on the first frame, when its size or address changes or when the color changes. Everything else
+ is left untouched so unchanged components keep their pixels.
+
+ \param theWhere image/frame used as back buffer. It must be kept alive between frames.
+ \param theColor background color in the format `0xRRGGBB`, e.g. `0xff0000` for red.
+
+ \sa beginRetained()
+*/
+void clear(cv::Mat& theWhere, unsigned int theColor);
+
+/**
+ Start a retained area, e.g. a window. Components rendered until `endRetained()` are only repainted when their
+ appearance (position, label, value, mouse state) changes since the last frame, the pixels of the previous frame are
+ kept otherwise. Only the changed regions are written to the frame, and `cvui::imshow()` skips pushing a frame in which
+ nothing changed at all.
+
+ Retained areas are composited in the order they are rendered. An area that is moved, resized or rendered over is
+ repainted as a whole, and regions it leaves uncovered are recomposited from the other areas at the end of the frame.
+
+ \param theWhere image/frame where the area is rendered, the same that is passed to `clear()`.
+ \param theId unique name of the area, e.g. the title of a window.
+ \param theArea region covered by the area. The area must be opaque: every pixel inside it is drawn by its components.
+ \param theBackgroundColor color beneath the components, used to erase a component before repainting it.
+
+ \sa endRetained()
+ \sa clear()
+*/
+void beginRetained(cv::Mat& theWhere, const cv::String& theId, cv::Rect theArea, unsigned int theBackgroundColor = 0x313131);
+
+/**
+ End a retained area started with `beginRetained()`.
+
+ \sa beginRetained()
+*/
+void endRetained();
+
+/**
+ Draw a string like `cv::putText()` does, but from a cache of rasterized strings. The first time a string is drawn
+ with a given font, scale, thickness and line type its coverage is rasterized into a mask; later calls only blend the
+ cached mask into the image with the requested color. All text rendered by cvui goes through this function, and it can
+ be used for any other labels that are drawn every frame. Every thread has its own cache.
+
+ \param theWhere image/frame where the text is drawn. Images that are not 8 bit with 1, 3 or 4 channels are drawn with `cv::putText()`.
+ \param theText the text content.
+ \param theOrigin bottom-left corner of the text, as in `cv::putText()`.
+ \param theFontFace one of the `cv::HersheyFonts`.
+ \param theFontScale size of the text.
+ \param theColor color of the text.
+ \param theThickness thickness of the strokes.
+ \param theLineType `cv::LINE_8` or `cv::LINE_AA`.
+*/
+void putTextCached(cv::Mat& theWhere, const cv::String& theText, cv::Point theOrigin, int theFontFace, double theFontScale, cv::Scalar theColor, int theThickness = 1, int theLineType = cv::LINE_8);
+
+/**
+ Blend a constant color over a rectangle of an image, in place. No temporary image is allocated, and the inner loop
+ runs over plain bytes so the compiler can vectorize it. This is what `rect()` uses for translucent fillings, and it
+ can be used to highlight regions of any 8 bit image.
+
+ \param theWhere image/frame that is blended into, 8 bit with any number of channels. Other depths are left untouched.
+ \param theRect region to blend, it is clipped to the image.
+ \param theColor color blended over the region.
+ \param theAlpha opacity of the color, from 0 (invisible) to 1 (opaque).
+ \param theMask optional CV_8UC1 mask the size of `theRect`, only pixels where it is non-zero are blended.
+
+ \sa rect()
+*/
+void blendRect(cv::Mat& theWhere, cv::Rect theRect, cv::Scalar theColor, double theAlpha, const cv::Mat& theMask = cv::Mat());
+
 // Internally used to handle mouse events
 void handleMouse(int theEvent, int theX, int theY, int theFlags, void* theData);
 
@@ -1231,6 +1321,65 @@ namespace internal
 	static int gStackCount = -1;
 	static const int gTrackbarMarginX = 14;
 
+	// Appearance of a component rendered inside a retained area during the last frame.
+	struct RetainedComponent {
+		cv::Rect rect;				// region the component painted.
+		size_t signature;			// hash of everything that affects how the component looks.
+	};
+
+	// A retained area, e.g. a window, see beginRetained().
+	struct RetainedArea {
+		cv::Rect area;				// region covered by the area.
+		cv::Rect visible;			// part of the area inside the frame.
+		cv::Mat surface;			// copy of the visible pixels, used to recomposite regions uncovered by other areas.
+		std::vector<RetainedComponent> components;	// components in the order they were rendered.
+		std::vector<cv::Rect> dirty;	// regions repainted during the current frame.
+		size_t cursor = 0;			// index of the next component rendered in the current frame.
+		unsigned int background = 0x313131;
+		bool repaint = false;		// the whole area is repainted in the current frame.
+		bool repaintNext = false;	// the whole area must be repainted in the next frame.
+	};
+
+	// Retained rendering state, shared by all windows.
+	struct RetainedState {
+		cv::Mat where;				// back buffer all retained areas are rendered to.
+		unsigned int clearColor = 0;
+		bool repaintAll = true;		// everything is repainted in the current frame.
+		bool frameDirty = false;	// something was painted in the current frame.
+		std::map<cv::String, RetainedArea> areas;
+		std::vector<cv::String> order;		// areas rendered in the current frame, bottom first.
+		std::vector<cv::Rect> damage;		// regions repainted in the current frame.
+		std::vector<cv::Rect> uncovered;	// regions left behind by areas that moved, shrank or vanished.
+		RetainedArea *current = nullptr;	// area between beginRetained() and endRetained().
+	};
+
+	static RetainedState gRetained;
+
+	// FNV-1a hash used to build component signatures.
+	struct Signature {
+		size_t value = 1469598103934665603ULL;
+
+		template<typename T>
+		Signature& add(const T& theValue) {
+			const unsigned char *aBytes = reinterpret_cast<const unsigned char *>(&theValue);
+			for (size_t i = 0; i < sizeof(T); i++) {
+				value = (value ^ aBytes[i]) * 1099511628211ULL;
+			}
+			return *this;
+		}
+
+		Signature& add(const std::string& theValue) {
+			for (unsigned char c : theValue) {
+				value = (value ^ c) * 1099511628211ULL;
+			}
+			return add(theValue.size());
+		}
+
+		Signature& add(const cv::Rect& theValue) {
+			return add(theValue.x).add(theValue.y).add(theValue.width).add(theValue.height);
+		}
+	};
+
 	bool isMouseButton(cvui_mouse_btn_t& theButton, int theQuery);
 	void resetMouseButton(cvui_mouse_btn_t& theButton);
 	void init(const cv::String& theWindowName, int theDelayWaitKey);
@@ -1249,7 +1398,7 @@ namespace internal
 	bool button(cvui_block_t& theBlock, int theX, int theY, int theWidth, int theHeight, const cv::String& theLabel, bool theUpdateLayout, double theFontScale, unsigned int theInsideColor);
 	bool button(cvui_block_t& theBlock, int theX, int theY, const cv::String& theLabel, double theFontScale, unsigned int theInsideColor);
 	bool button(cvui_block_t& theBlock, int theX, int theY, cv::Mat& theIdle, cv::Mat& theOver, cv::Mat& theDown, bool theUpdateLayout);
-	void image(cvui_block_t& theBlock, int theX, int theY, cv::Mat& theImage);
+	void image(cvui_block_t& theBlock, int theX, int theY, cv::Mat& theImage, size_t theRevision = 0);
 	bool checkbox(cvui_block_t& theBlock, int theX, int theY, const cv::String& theLabel, bool *theState, unsigned int theColor, double theFontScale);
 	void text(cvui_block_t& theBlock, int theX, int theY, const cv::String& theText, double theFontScale, unsigned int theColor, bool theUpdateLayout);
 	int counter(cvui_block_t& theBlock, int theX, int theY, int *theValue, int theStep, const char *theFormat, double theFontScale);
@@ -1268,6 +1417,13 @@ namespace internal
 	unsigned int darkenColor(unsigned int theColor, unsigned int theDelta);
 	uint8_t brightnessOfColor(unsigned int theColor);
 	void resetRenderingBuffer(cvui_block_t& theScreen);
+	void retainedAttach(cv::Mat& theWhere);
+	void retainedMarkDirty(RetainedArea& theArea, const cv::Rect& theRect);
+	void retainedErase(RetainedArea& theArea, const cv::Rect& theRect);
+	bool retainedRender(const cv::Rect& theRect, size_t theSignature, bool theOpaque);
+	bool retainedFlush();
+	const cv::Mat& textMask(const cv::String& theText, int theFontFace, double theFontScale, int theThickness, int theLineType, cv::Point& theOffset);
+	void blendMask(cv::Mat& theWhere, const cv::Mat& theMask, cv::Point theTopLeft, cv::Scalar theColor);
 
 	template <typename T> // T can be any floating point type (float, double, long double)
 	TrackbarParams makeTrackbarParams(T min, T max, int theDecimals = 1, int theSegments = 1, T theStep = -1., unsigned int theOptions = 0, const char *theFormat = "%.1Lf", double theFontScale = DEFAULT_FONT_SCALE);
@@ -1638,6 +1794,199 @@ namespace internal
 		theScreen.padding = 0;
 	}
 
+	void retainedAttach(cv::Mat& theWhere) {
+		RetainedState& aState = gRetained;
+
+		// A new back buffer holds none of the retained pixels
+		if (aState.where.data != theWhere.data || aState.where.size() != theWhere.size()) {
+			aState.where = theWhere;
+			aState.repaintAll = true;
+		}
+	}
+
+	void retainedMarkDirty(RetainedArea& theArea, const cv::Rect& theRect) {
+		cv::Rect aRect = theRect & theArea.visible;
+
+		if (aRect.area() > 0) {
+			theArea.dirty.push_back(aRect);
+			gRetained.damage.push_back(aRect);
+		}
+	}
+
+	void retainedErase(RetainedArea& theArea, const cv::Rect& theRect) {
+		cv::Rect aRect = theRect & theArea.visible;
+
+		if (aRect.area() > 0) {
+			cv::rectangle(gRetained.where, aRect, hexToScalar(theArea.background), CVUI_FILLED);
+		}
+	}
+
+	bool retainedRender(const cv::Rect& theRect, size_t theSignature, bool theOpaque) {
+		RetainedState& aState = gRetained;
+
+		// Components outside of retained areas are rendered every frame
+		if (aState.current == nullptr) {
+			aState.frameDirty = true;
+			return true;
+		}
+
+		RetainedArea& aArea = *aState.current;
+		bool aIsNew = aArea.cursor == aArea.components.size();
+
+		if (aIsNew) {
+			aArea.components.push_back({ theRect, theSignature });
+		}
+
+		RetainedComponent& aComponent = aArea.components[aArea.cursor++];
+		bool aChanged = aArea.repaint || aIsNew || aComponent.rect != theRect || aComponent.signature != theSignature;
+
+		// Repaint components that were partly erased by a component rendered before them
+		for (size_t i = 0; !aChanged && i < aArea.dirty.size(); i++) {
+			aChanged = (aArea.dirty[i] & theRect).area() > 0;
+		}
+
+		if (aChanged && !aArea.repaint) {
+			if (aComponent.rect != theRect) {
+				retainedErase(aArea, aComponent.rect);
+				retainedMarkDirty(aArea, aComponent.rect);
+			}
+			if (!theOpaque) {
+				retainedErase(aArea, theRect);
+			}
+			retainedMarkDirty(aArea, theRect);
+
+			// Components skipped earlier in this frame cannot be repainted anymore if they were
+			// erased, so the area is repainted as a whole in the next frame.
+			cv::Rect aErased = theOpaque ? aComponent.rect : (aComponent.rect | theRect);
+			for (size_t i = 0; i + 1 < aArea.cursor; i++) {
+				if ((aArea.components[i].rect & aErased).area() > 0) {
+					aArea.repaintNext = true;
+				}
+			}
+		}
+
+		aComponent.rect = theRect;
+		aComponent.signature = theSignature;
+
+		if (aChanged) {
+			aState.frameDirty = true;
+		}
+
+		return aChanged;
+	}
+
+	bool retainedFlush() {
+		RetainedState& aState = gRetained;
+		cv::Rect aBounds(0, 0, aState.where.cols, aState.where.rows);
+
+		// Areas that were not rendered in this frame have vanished
+		for (auto& aEntry : aState.areas) {
+			RetainedArea& aArea = aEntry.second;
+			bool aRendered = std::find(aState.order.begin(), aState.order.end(), aEntry.first) != aState.order.end();
+
+			if (!aRendered && aArea.visible.area() > 0) {
+				aState.uncovered.push_back(aArea.visible);
+				aArea.area = aArea.visible = cv::Rect();
+				aArea.surface.release();
+				aArea.components.clear();
+			}
+		}
+
+		// Recomposite uncovered regions from the background and the surfaces of the remaining areas
+		for (auto& aRegion : aState.uncovered) {
+			cv::Rect aRect = aRegion & aBounds;
+
+			if (aRect.area() <= 0) {
+				continue;
+			}
+
+			cv::rectangle(aState.where, aRect, hexToScalar(aState.clearColor), CVUI_FILLED);
+
+			for (auto& aId : aState.order) {
+				RetainedArea& aArea = aState.areas[aId];
+				cv::Rect aOverlap = aRect & aArea.visible;
+
+				if (aOverlap.area() > 0 && aArea.surface.size() == aArea.visible.size()) {
+					aArea.surface(aOverlap - aArea.visible.tl()).copyTo(aState.where(aOverlap));
+				}
+			}
+
+			aState.frameDirty = true;
+		}
+
+		// Frames without retained areas are always pushed
+		bool aDirty = aState.frameDirty || aState.order.empty();
+
+		aState.order.clear();
+		aState.damage.clear();
+		aState.uncovered.clear();
+		aState.frameDirty = false;
+		aState.repaintAll = false;
+
+		return aDirty;
+	}
+
+	struct TextMask {
+		cv::Mat mask;
+		cv::Point offset;
+	};
+
+	const cv::Mat& textMask(const cv::String& theText, int theFontFace, double theFontScale, int theThickness, int theLineType, cv::Point& theOffset) {
+		// Rasterized strings are few and small, the cache is simply dropped when it grows too big (e.g. values that keep changing)
+		static thread_local std::unordered_map<std::string, TextMask> aCache;
+		const size_t aCapacity = 1024;
+
+		std::string aKey = theText;
+		aKey.push_back('\0');
+		aKey.append((const char *)&theFontFace, sizeof(theFontFace));
+		aKey.append((const char *)&theFontScale, sizeof(theFontScale));
+		aKey.append((const char *)&theThickness, sizeof(theThickness));
+		aKey.append((const char *)&theLineType, sizeof(theLineType));
+
+		auto aFound = aCache.find(aKey);
+		if (aFound == aCache.end()) {
+			if (aCache.size() >= aCapacity) {
+				aCache.clear();
+			}
+
+			int aBaseline = 0;
+			cv::Size aSize = cv::getTextSize(theText, theFontFace, theFontScale, theThickness, &aBaseline);
+			int aPadding = theThickness + 2;
+			cv::Point aOrigin(aPadding, aPadding + aSize.height);
+
+			TextMask& aEntry = aCache[aKey];
+			aEntry.mask = cv::Mat::zeros(aSize.height + aBaseline + 2 * aPadding, aSize.width + 2 * aPadding, CV_8UC1);
+			aEntry.offset = -aOrigin;
+			cv::putText(aEntry.mask, theText, aOrigin, theFontFace, theFontScale, cv::Scalar(255), theThickness, theLineType);
+			aFound = aCache.find(aKey);
+		}
+
+		theOffset = aFound->second.offset;
+		return aFound->second.mask;
+	}
+
+	void blendMask(cv::Mat& theWhere, const cv::Mat& theMask, cv::Point theTopLeft, cv::Scalar theColor) {
+		cv::Rect aRect = cv::Rect(theTopLeft, theMask.size()) & cv::Rect(0, 0, theWhere.cols, theWhere.rows);
+		int aChannels = theWhere.channels();
+		int aColor[4] = { cvRound(theColor[0]), cvRound(theColor[1]), cvRound(theColor[2]), cvRound(theColor[3]) };
+
+		for (int y = aRect.y; y < aRect.y + aRect.height; y++) {
+			const uchar *aCoverage = theMask.ptr<uchar>(y - theTopLeft.y) + (aRect.x - theTopLeft.x);
+			uchar *aPixel = theWhere.ptr<uchar>(y) + aRect.x * aChannels;
+
+			for (int x = 0; x < aRect.width; x++, aPixel += aChannels) {
+				int aAlpha = aCoverage[x];
+
+				if (aAlpha == 0) {
+					continue;
+				}
+				for (int c = 0; c < aChannels; c++) {
+					aPixel[c] = (uchar)((aPixel[c] * (255 - aAlpha) + aColor[c] * aAlpha + 127) / 255);
+				}
+			}
+		}
+	}
+
 
 	inline long double clamp01(long double value)
 	{
@@ -1705,8 +2054,13 @@ namespace internal
 
 		// Render the button according to mouse interaction, e.g. OVER, DOWN, OUT.
 		int aStatus = cvui::iarea(theX, theY, aRect.width, aRect.height);
-		render::button(theBlock, aStatus, aRect, theFontScale, theInsideColor);
-		render::buttonLabel(theBlock, aStatus, aRect, theLabel, aTextSize, theFontScale, theInsideColor);
+		Signature aSignature;
+		aSignature.add(aStatus).add(theLabel).add(theFontScale).add(theInsideColor);
+
+		if (retainedRender(aRect, aSignature.value, true)) {
+			render::button(theBlock, aStatus, aRect, theFontScale, theInsideColor);
+			render::buttonLabel(theBlock, aStatus, aRect, theLabel, aTextSize, theFontScale, theInsideColor);
+		}
 
 		// Update the layout flow according to button size
 		// if we were told to update.
@@ -1741,11 +2095,15 @@ namespace internal
 	bool button(cvui_block_t& theBlock, int theX, int theY, cv::Mat& theIdle, cv::Mat& theOver, cv::Mat& theDown, bool theUpdateLayout) {
 		cv::Rect aRect(theX, theY, theIdle.cols, theIdle.rows);
 		int aStatus = cvui::iarea(theX, theY, aRect.width, aRect.height);
-
-		switch (aStatus) {
-			case cvui::OUT: render::image(theBlock, aRect, theIdle); break;
-			case cvui::OVER: render::image(theBlock, aRect, theOver); break;
-			case cvui::DOWN: render::image(theBlock, aRect, theDown); break;
+		Signature aSignature;
+		aSignature.add(aStatus).add(theIdle.data).add(theOver.data).add(theDown.data);
+
+		if (retainedRender(aRect, aSignature.value, true)) {
+			switch (aStatus) {
+				case cvui::OUT: render::image(theBlock, aRect, theIdle); break;
+				case cvui::OVER: render::image(theBlock, aRect, theOver); break;
+				case cvui::DOWN: render::image(theBlock, aRect, theDown); break;
+			}
 		}
 
 		// Update the layout flow according to button size
@@ -1759,11 +2117,18 @@ namespace internal
 		return aStatus == cvui::CLICK;
 	}
 
-	void image(cvui_block_t& theBlock, int theX, int theY, cv::Mat& theImage) {
+	void image(cvui_block_t& theBlock, int theX, int theY, cv::Mat& theImage, size_t theRevision) {
 		cv::Rect aRect(theX, theY, theImage.cols, theImage.rows);
 
+		// Without a revision there is no telling whether the pixels changed, so they are always copied
+		static size_t aUnknownRevision = 0;
+		Signature aSignature;
+		aSignature.add(theImage.type()).add(theRevision != 0 ? theRevision : ++aUnknownRevision);
+
 		// TODO: check for render outside the frame area
-		render::image(theBlock, aRect, theImage);
+		if (retainedRender(aRect, aSignature.value, true)) {
+			render::image(theBlock, aRect, theImage);
+		}
 
 		// Update the layout flow according to image size
 		cv::Size aSize(theImage.cols, theImage.rows);
@@ -1777,20 +2142,20 @@ namespace internal
 		cv::Rect aHitArea(theX, theY, aRect.width + aTextSize.width + 6, aRect.height);
 		bool aMouseIsOver = aHitArea.contains(aMouse.position);
 
-		if (aMouseIsOver) {
-			render::checkbox(theBlock, cvui::OVER, aRect);
-
-			if (aMouse.anyButton.justReleased) {
-				*theState = !(*theState);
-			}
-		} else {
-			render::checkbox(theBlock, cvui::OUT, aRect);
+		if (aMouseIsOver && aMouse.anyButton.justReleased) {
+			*theState = !(*theState);
 		}
 
-		render::checkboxLabel(theBlock, aRect, theLabel, aTextSize, theColor, theFontScale);
+		Signature aSignature;
+		aSignature.add(aMouseIsOver).add(*theState).add(theLabel).add(theColor).add(theFontScale);
+
+		if (retainedRender(aHitArea, aSignature.value, false)) {
+			render::checkbox(theBlock, aMouseIsOver ? cvui::OVER : cvui::OUT, aRect);
+			render::checkboxLabel(theBlock, aRect, theLabel, aTextSize, theColor, theFontScale);
 
-		if (*theState) {
-			render::checkboxCheck(theBlock, aRect);
+			if (*theState) {
+				render::checkboxCheck(theBlock, aRect);
+			}
 		}
 
 		// Update the layout flow
@@ -1801,10 +2166,18 @@ namespace internal
 	}
 
 	void text(cvui_block_t& theBlock, int theX, int theY, const cv::String& theText, double theFontScale, unsigned int theColor, bool theUpdateLayout) {
-		cv::Size aTextSize = cv::getTextSize(theText, cv::FONT_HERSHEY_SIMPLEX, theFontScale, 1, nullptr);
+		int aBaseline = 0;
+		cv::Size aTextSize = cv::getTextSize(theText, cv::FONT_HERSHEY_SIMPLEX, theFontScale, 1, &aBaseline);
 		cv::Point aPos(theX, theY + aTextSize.height);
 
-		render::text(theBlock, theText, aPos, theFontScale, theColor);
+		// Anti-aliased glyphs and descenders reach slightly outside the nominal text box
+		cv::Rect aRect(theX - 1, theY, aTextSize.width + 2, aTextSize.height + aBaseline);
+		Signature aSignature;
+		aSignature.add(theText).add(theFontScale).add(theColor);
+
+		if (retainedRender(aRect, aSignature.value, false)) {
+			render::text(theBlock, theText, aPos, theFontScale, theColor);
+		}
 
 		if (theUpdateLayout) {
 			// Add an extra pixel to the height to overcome OpenCV font size problems.
@@ -1823,7 +2196,12 @@ namespace internal
 		}
 
 		sprintf_s(internal::gBuffer, theFormat, *theValue);
-		render::counter(theBlock, aContentArea, internal::gBuffer, theFontScale);
+		Signature aSignature;
+		aSignature.add(cv::String(internal::gBuffer)).add(theFontScale);
+
+		if (retainedRender(aContentArea, aSignature.value, true)) {
+			render::counter(theBlock, aContentArea, internal::gBuffer, theFontScale);
+		}
 
 		if (internal::button(theBlock, aContentArea.x + aContentArea.width, theY, std::lround(22 * scale), std::lround(22 * scale), "+", false, theFontScale, theInsideColor)) {
 			*theValue += theStep;
@@ -1845,7 +2223,12 @@ namespace internal
 		}
 
 		sprintf_s(internal::gBuffer, theFormat, *theValue);
-		render::counter(theBlock, aContentArea, internal::gBuffer, theFontScale);
+		Signature aSignature;
+		aSignature.add(cv::String(internal::gBuffer)).add(theFontScale);
+
+		if (retainedRender(aContentArea, aSignature.value, true)) {
+			render::counter(theBlock, aContentArea, internal::gBuffer, theFontScale);
+		}
 
 		if (internal::button(theBlock, aContentArea.x + aContentArea.width, theY, std::lround(22 * scale), std::lround(22 * scale), "+", false, theFontScale, theInsideColor)) {
 			*theValue += theStep;
@@ -1864,7 +2247,14 @@ namespace internal
 		long double aValue = *theValue;
 		bool aMouseIsOver = aContentArea.contains(aMouse.position);
 
-		render::trackbar(theBlock, aMouseIsOver ? OVER : OUT, aContentArea, (double)*theValue, theParams);
+		// long double carries padding bytes, so values are hashed as double
+		Signature aSignature;
+		aSignature.add(aMouseIsOver).add((double)*theValue).add((double)theParams.min).add((double)theParams.max).add((double)theParams.step);
+		aSignature.add(theParams.segments).add(theParams.options).add(theParams.labelFormat).add(theParams.fontScale);
+
+		if (retainedRender(aContentArea, aSignature.value, false)) {
+			render::trackbar(theBlock, aMouseIsOver ? OVER : OUT, aContentArea, (double)*theValue, theParams);
+		}
 
 		if (aMouse.anyButton.pressed && aMouseIsOver) {
 			*theValue = internal::trackbarXPixelToValue(theParams, aContentArea, aMouse.position.x);
@@ -1885,8 +2275,12 @@ namespace internal
 	void window(cvui_block_t& theBlock, int theX, int theY, int theWidth, int theHeight, const cv::String& theTitle, double theFontScale) {
 		cv::Rect aTitleBar(theX, theY, theWidth, std::lround(20*theFontScale/DEFAULT_FONT_SCALE));
 		cv::Rect aContent(theX, theY + aTitleBar.height, theWidth, theHeight - aTitleBar.height);
+		Signature aSignature;
+		aSignature.add(theTitle).add(theFontScale);
 
-		render::window(theBlock, aTitleBar, aContent, theTitle, theFontScale);
+		if (retainedRender(cv::Rect(theX, theY, theWidth, theHeight), aSignature.value, true)) {
+			render::window(theBlock, aTitleBar, aContent, theTitle, theFontScale);
+		}
 
 		// Update the layout flow
 		cv::Size aSize(theWidth, theHeight);
@@ -1902,7 +2296,12 @@ namespace internal
 		aRect.width = std::abs(aRect.width);
 		aRect.height = std::abs(aRect.height);
 
-		render::rect(theBlock, aRect, theBorderColor, theFillingColor);
+		Signature aSignature;
+		aSignature.add(theBorderColor).add(theFillingColor);
+
+		if (retainedRender(aRect, aSignature.value, false)) {
+			render::rect(theBlock, aRect, theBorderColor, theFillingColor);
+		}
 
 		// Update the layout flow
 		cv::Size aSize(aRect.width, aRect.height);
@@ -1914,11 +2313,21 @@ namespace internal
 		cv::Rect aRect(theX, theY, theWidth, theHeight);
 		std::vector<double>::size_type aHowManyValues = theValues.size();
 
-		if (aHowManyValues >= 2) {
-			internal::findMinMax(theValues, &aMin, &aMax);
-			render::sparkline(theBlock, theValues, aRect, aMin, aMax, theColor);
-		} else {
-			internal::text(theBlock, theX, theY, aHowManyValues == 0 ? "No data." : "Insufficient data points.", DEFAULT_FONT_SCALE, 0xCECECE, false);
+		Signature aSignature;
+		aSignature.add(theColor).add(aHowManyValues);
+		for (double aValue : theValues) {
+			aSignature.add(aValue);
+		}
+
+		if (retainedRender(aRect, aSignature.value, false)) {
+			if (aHowManyValues >= 2) {
+				internal::findMinMax(theValues, &aMin, &aMax);
+				render::sparkline(theBlock, theValues, aRect, aMin, aMax, theColor);
+			} else {
+				cv::String aMessage = aHowManyValues == 0 ? "No data." : "Insufficient data points.";
+				cv::Point aPos(theX, theY + cv::getTextSize(aMessage, cv::FONT_HERSHEY_SIMPLEX, DEFAULT_FONT_SCALE, 1, nullptr).height);
+				render::text(theBlock, aMessage, aPos, DEFAULT_FONT_SCALE, 0xCECECE);
+			}
 		}
 
 		// Update the layout flow
@@ -1932,7 +2341,7 @@ namespace internal
 namespace render
 {
 	void text(cvui_block_t& theBlock, const cv::String& theText, cv::Point& thePos, double theFontScale, unsigned int theColor) {
-		cv::putText(theBlock.where, theText, thePos, cv::FONT_HERSHEY_SIMPLEX, theFontScale, internal::hexToScalar(theColor), 1, CVUI_ANTIALISED);
+		cvui::putTextCached(theBlock.where, theText, thePos, cv::FONT_HERSHEY_SIMPLEX, theFontScale, internal::hexToScalar(theColor), 1, CVUI_ANTIALISED);
 	}
 
 	void button(cvui_block_t& theBlock, int theState, cv::Rect& theShape, double theFontScale, unsigned int theInsideColor) {
@@ -1973,7 +2382,7 @@ namespace render
 		cv::Size aSize;
 
 		if (theText != "") {
-			cv::putText(theBlock.where, theText, thePosition, cv::FONT_HERSHEY_SIMPLEX, aFontSize, aColor, 1, CVUI_ANTIALISED);
+			cvui::putTextCached(theBlock.where, theText, thePosition, cv::FONT_HERSHEY_SIMPLEX, aFontSize, aColor, 1, CVUI_ANTIALISED);
 			aSize = cv::getTextSize(theText, cv::FONT_HERSHEY_SIMPLEX, aFontSize, 1, nullptr);
 		}
 
@@ -1983,7 +2392,7 @@ namespace render
 	int putTextCentered(cvui_block_t& theBlock, const cv::Point & position, const std::string &text, double theFontScale) {
 		auto size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, theFontScale, 1, nullptr);
 		cv::Point positionDecentered(position.x - size.width / 2, position.y);
-		cv::putText(theBlock.where, text, positionDecentered, cv::FONT_HERSHEY_SIMPLEX, theFontScale, cv::Scalar(0xCE, 0xCE, 0xCE), 1, CVUI_ANTIALISED);
+		cvui::putTextCached(theBlock.where, text, positionDecentered, cv::FONT_HERSHEY_SIMPLEX, theFontScale, cv::Scalar(0xCE, 0xCE, 0xCE), 1, CVUI_ANTIALISED);
 
 		return size.width;
 	}
@@ -2063,7 +2472,7 @@ namespace render
 		cv::Size aTextSize = getTextSize(theValue, cv::FONT_HERSHEY_SIMPLEX, theFontScale, 1, nullptr);
 
 		cv::Point aPos(theShape.x + theShape.width / 2 - aTextSize.width / 2, theShape.y + aTextSize.height / 2 + theShape.height / 2);
-		cv::putText(theBlock.where, theValue, aPos, cv::FONT_HERSHEY_SIMPLEX, theFontScale, cv::Scalar(0xCE, 0xCE, 0xCE), 1, CVUI_ANTIALISED);
+		cvui::putTextCached(theBlock.where, theValue, aPos, cv::FONT_HERSHEY_SIMPLEX, theFontScale, cv::Scalar(0xCE, 0xCE, 0xCE), 1, CVUI_ANTIALISED);
 	}
 
 	void trackbarHandle(cvui_block_t& theBlock, int theState, cv::Rect& theShape, double theValue, const internal::TrackbarParams &theParams, cv::Rect& theWorkingArea) {
@@ -2216,7 +2625,7 @@ namespace render
 
 		// Render title text.
 		cv::Point aPos(theTitleBar.x + 5, theTitleBar.y + std::lround(12 * theFontScale/DEFAULT_FONT_SCALE));
-		cv::putText(theBlock.where, theTitle, aPos, cv::FONT_HERSHEY_SIMPLEX, theFontScale, cv::Scalar(0xCE, 0xCE, 0xCE), 1, CVUI_ANTIALISED);
+		cvui::putTextCached(theBlock.where, theTitle, aPos, cv::FONT_HERSHEY_SIMPLEX, theFontScale, cv::Scalar(0xCE, 0xCE, 0xCE), 1, CVUI_ANTIALISED);
 
 		// Render the body.
 		// First the border.
@@ -2249,10 +2658,8 @@ namespace render
 				cv::rectangle(theBlock.where, thePos, aFilling, CVUI_FILLED, CVUI_ANTIALISED);
 			}
 			else {
-				cv::Rect aClippedRect = thePos & cv::Rect(cv::Point(0, 0), theBlock.where.size());
 				double aAlpha = 1.00 - static_cast<double>(aFilling[3]) / 255;
-				cv::Mat aOverlay(aClippedRect.size(), theBlock.where.type(), aFilling);
-				cv::addWeighted(aOverlay, aAlpha, theBlock.where(aClippedRect), 1.00 - aAlpha, 0.0, theBlock.where(aClippedRect));
+				cvui::blendRect(theBlock.where, thePos, aFilling, aAlpha);
 			}
 		}
 
@@ -2321,8 +2728,13 @@ void context(const cv::String& theWindowName) {
 }
 
 void imshow(const cv::String& theWindowName, cv::InputArray theFrame) {
+	bool aDirty = internal::retainedFlush();
 	cvui::update(theWindowName);
-	cv::imshow(theWindowName, theFrame);
+
+	// Nothing changed, the window still shows the current pixels
+	if (aDirty) {
+		cv::imshow(theWindowName, theFrame);
+	}
 }
 
 int lastKeyPressed() {
@@ -2493,6 +2905,11 @@ void image(cv::Mat& theImage) {
 	return internal::image(aBlock, aBlock.anchor.x, aBlock.anchor.y, theImage);
 }
 
+void image(cv::Mat& theImage, size_t theRevision) {
+	cvui_block_t& aBlock = internal::topBlock();
+	return internal::image(aBlock, aBlock.anchor.x, aBlock.anchor.y, theImage, theRevision);
+}
+
 bool checkbox(const cv::String& theLabel, bool *theState, unsigned int theColor, double theFontScale) {
 	cvui_block_t& aBlock = internal::topBlock();
 	return internal::checkbox(aBlock, aBlock.anchor.x, aBlock.anchor.y, theLabel, theState, theColor, theFontScale);
@@ -2574,6 +2991,152 @@ void update(const cv::String& theWindowName) {
 	}
 }
 
+void clear(cv::Mat& theWhere, unsigned int theColor) {
+	internal::RetainedState& aState = internal::gRetained;
+
+	internal::retainedAttach(theWhere);
+
+	if (aState.clearColor != theColor) {
+		aState.clearColor = theColor;
+		aState.repaintAll = true;
+	}
+
+	if (aState.repaintAll) {
+		theWhere = internal::hexToScalar(theColor);
+		aState.frameDirty = true;
+	}
+}
+
+void beginRetained(cv::Mat& theWhere, const cv::String& theId, cv::Rect theArea, unsigned int theBackgroundColor) {
+	internal::RetainedState& aState = internal::gRetained;
+
+	if (aState.current != nullptr) {
+		internal::error(7, "Retained areas cannot be nested. Did you forget to call endRetained()?");
+	}
+
+	internal::retainedAttach(theWhere);
+
+	internal::RetainedArea& aArea = aState.areas[theId];
+	cv::Rect aVisible = theArea & cv::Rect(0, 0, theWhere.cols, theWhere.rows);
+	bool aMoved = aArea.area != theArea;
+	bool aDamaged = false;
+
+	// Areas rendered earlier in this frame lie below this one. If they painted into it, it has to be painted over them again.
+	for (auto& aRect : aState.damage) {
+		aDamaged = aDamaged || (aRect & aVisible).area() > 0;
+	}
+
+	if (aMoved && aArea.visible.area() > 0) {
+		aState.uncovered.push_back(aArea.visible);
+	}
+
+	aArea.area = theArea;
+	aArea.visible = aVisible;
+	aArea.background = theBackgroundColor;
+	aArea.cursor = 0;
+	aArea.dirty.clear();
+	aArea.repaint = aState.repaintAll || aMoved || aDamaged || aArea.repaintNext || aArea.surface.empty();
+	aArea.repaintNext = false;
+
+	if (aArea.repaint) {
+		internal::retainedMarkDirty(aArea, aVisible);
+		aState.frameDirty = true;
+	}
+
+	aState.order.push_back(theId);
+	aState.current = &aArea;
+}
+
+void endRetained() {
+	internal::RetainedState& aState = internal::gRetained;
+
+	if (aState.current == nullptr) {
+		internal::error(8, "Calling endRetained() without a matching beginRetained().");
+	}
+
+	internal::RetainedArea& aArea = *aState.current;
+	aState.current = nullptr;
+
+	// Components that were not rendered this frame leave their pixels behind
+	for (size_t i = aArea.cursor; !aArea.repaint && i < aArea.components.size(); i++) {
+		internal::retainedErase(aArea, aArea.components[i].rect);
+		internal::retainedMarkDirty(aArea, aArea.components[i].rect);
+		aState.frameDirty = true;
+	}
+	aArea.components.resize(aArea.cursor);
+
+	if (aArea.visible.area() <= 0) {
+		aArea.surface.release();
+		return;
+	}
+
+	// Keep the surface in sync with the pixels that changed
+	if (aArea.repaint || aArea.surface.size() != aArea.visible.size()) {
+		aState.where(aArea.visible).copyTo(aArea.surface);
+	} else {
+		for (auto& aRect : aArea.dirty) {
+			aState.where(aRect).copyTo(aArea.surface(aRect - aArea.visible.tl()));
+		}
+	}
+}
+
+void putTextCached(cv::Mat& theWhere, const cv::String& theText, cv::Point theOrigin, int theFontFace, double theFontScale, cv::Scalar theColor, int theThickness, int theLineType) {
+	if (theWhere.depth() != CV_8U || theWhere.channels() == 2 || theWhere.channels() > 4) {
+		cv::putText(theWhere, theText, theOrigin, theFontFace, theFontScale, theColor, theThickness, theLineType);
+		return;
+	}
+
+	cv::Point aOffset;
+	const cv::Mat& aMask = internal::textMask(theText, theFontFace, theFontScale, theThickness, theLineType, aOffset);
+	internal::blendMask(theWhere, aMask, theOrigin + aOffset, theColor);
+}
+
+void blendRect(cv::Mat& theWhere, cv::Rect theRect, cv::Scalar theColor, double theAlpha, const cv::Mat& theMask) {
+	cv::Rect aRect = theRect & cv::Rect(0, 0, theWhere.cols, theWhere.rows);
+
+	if (aRect.area() <= 0 || theWhere.depth() != CV_8U) {
+		return;
+	}
+
+	// Fixed point weights out of 256
+	int aChannels = theWhere.channels();
+	int aAlpha = cvRound(std::min(1.0, std::max(0.0, theAlpha)) * 256);
+	int aInverse = 256 - aAlpha;
+	size_t aRowBytes = (size_t)aRect.width * aChannels;
+
+	// The color premultiplied by alpha and repeated for a whole row, so every byte of a row is blended the same way.
+	// The buffer only grows, so after the first frames no memory is allocated at all.
+	static thread_local std::vector<uint16_t> aColorRow;
+	if (aColorRow.size() < aRowBytes) {
+		aColorRow.resize(aRowBytes);
+	}
+	for (size_t i = 0; i < aRowBytes; i++) {
+		aColorRow[i] = (uint16_t)(cvRound(theColor[i % aChannels]) * aAlpha + 128);
+	}
+	const uint16_t *aColor = aColorRow.data();
+
+	for (int y = aRect.y; y < aRect.y + aRect.height; y++) {
+		uchar *aPixel = theWhere.ptr<uchar>(y) + aRect.x * aChannels;
+
+		if (theMask.empty()) {
+			for (size_t i = 0; i < aRowBytes; i++) {
+				aPixel[i] = (uchar)((aPixel[i] * aInverse + aColor[i]) >> 8);
+			}
+		} else {
+			const uchar *aMask = theMask.ptr<uchar>(y - theRect.y) + (aRect.x - theRect.x);
+
+			for (int x = 0; x < aRect.width; x++) {
+				if (aMask[x] != 0) {
+					for (int c = 0; c < aChannels; c++) {
+						size_t i = (size_t)x * aChannels + c;
+						aPixel[i] = (uchar)((aPixel[i] * aInverse + aColor[i]) >> 8);
+					}
+				}
+			}
+		}
+	}
+}
+
 void handleMouse(int theEvent, int theX, int theY, int /*theFlags*/, void* theData) {
 	int aButtons[3] = { cvui::LEFT_BUTTON, cvui::MIDDLE_BUTTON, cvui::RIGHT_BUTTON };
 	int aEventsDown[3] = { cv::EVENT_LBUTTONDOWN, cv::EVENT_MBUTTONDOWN, cv::EVENT_RBUTTONDOWN };
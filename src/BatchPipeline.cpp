@@ -0,0 +1,296 @@
+#include "BatchPipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "opencv2/imgcodecs.hpp"
+
+#include "BoundedQueue.h"
+#include "ReducedImage.h"
+#include "StageTimings.h"
+
+
+// An image on its way through the pipeline
+struct BatchItem
+{
+	size_t index = 0;
+	cv::Mat color;								// At full resolution
+	std::unique_ptr<ReducedImage> reduced;		// Instead of color when decoding reduced
+	bool decoded = false;
+	int64_t timestamp_us = 0;					// When the reader decoded it, since the batch started
+	DetectionResult result;
+};
+
+
+// Depth samples of a queue taken by one consumer thread
+struct DepthSamples
+{
+	size_t count = 0;
+	size_t sum = 0;
+	size_t max = 0;
+
+	void add(size_t depth)
+	{
+		count++;
+		sum += depth;
+		max = std::max(max, depth);
+	}
+};
+
+
+static QueueUsage queueUsage(const std::vector<DepthSamples>& samples, size_t capacity)
+{
+	QueueUsage usage;
+	usage.capacity = capacity;
+	size_t count = 0;
+	size_t sum = 0;
+	for (const auto& s: samples)
+	{
+		count += s.count;
+		sum += s.sum;
+		usage.max_depth = std::max(usage.max_depth, s.max);
+	}
+	usage.mean_depth = count > 0 ? double(sum) / count : 0;
+	return usage;
+}
+
+
+BatchReport runBatch(const std::vector<std::string>& paths, const BatchOptions& options, std::ostream& out, ResultsWriter* results)
+{
+	BatchReport report;
+	report.images = paths.size();
+	report.read.threads = std::max(1, options.readers);
+	report.recognize.threads = std::max(1, options.workers);
+	report.write.threads = 1;
+
+	BoundedQueue<std::unique_ptr<BatchItem>> prefetch(options.prefetch);
+	BoundedQueue<std::unique_ptr<BatchItem>> finished((size_t)report.recognize.threads);
+
+	// Images between the next one to write and the last one a reader may start on
+	const size_t window = prefetch.capacity() + finished.capacity() + report.recognize.threads;
+	std::mutex order_mutex;
+	std::condition_variable order_changed;
+	size_t written = 0;
+
+	std::vector<double> read_busy(report.read.threads, 0);
+	std::vector<double> recognize_busy(report.recognize.threads, 0);
+	std::vector<double> full_decode_busy(report.recognize.threads, 0);
+	std::vector<DepthSamples> prefetch_depths(report.recognize.threads);
+	DepthSamples finished_depths;
+
+	auto start = std::chrono::steady_clock::now();
+	std::atomic<size_t> next(0);
+
+	auto read = [&](int reader)
+	{
+		size_t i;
+		while ((i = next++) < paths.size())
+		{
+			{
+				std::unique_lock<std::mutex> lock(order_mutex);
+				order_changed.wait(lock, [&] { return i < written + window; });
+			}
+
+			StageClock clock;
+			auto item = std::make_unique<BatchItem>();
+			item->index = i;
+			if (options.reduction > 1)
+			{
+				item->reduced = std::make_unique<ReducedImage>(paths[i], options.reduction);
+				item->decoded = !item->reduced->empty();
+			}
+			else
+			{
+				item->color = cv::imread(paths[i]);
+				item->decoded = !item->color.empty();
+			}
+			item->timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+			read_busy[reader] += clock.lap();
+			prefetch.push(std::move(item));
+		}
+	};
+
+	auto recognize = [&](int worker)
+	{
+		// Every worker loads its own templates, the detector keeps per frame state
+		CardDetector detector;
+		detector.gauss_params = options.settings.gauss;
+		detector.canny_params = options.settings.canny;
+		detector.card_views = false;
+		detector.stage_images = false;
+
+		std::unique_ptr<BatchItem> item;
+		for (;;)
+		{
+			prefetch_depths[worker].add(prefetch.size());
+			if (!prefetch.pop(item))
+			{
+				break;
+			}
+
+			StageClock clock;
+			if (item->decoded)
+			{
+				if (item->reduced)
+				{
+					detector.processReduced(*item->reduced, item->result);
+				}
+				else
+				{
+					detector.processTiled(item->color, options.tiling, item->result);
+				}
+			}
+
+			// Only the cards go on, holding stage images would keep the detector from reusing its buffers
+			item->result.pipe_out.clear();
+			item->result.card_data.clear();
+			item->color.release();
+
+			// Only the worker knows whether a card needs the full resolution, it decodes it from the bytes the reader read
+			double full_decode_ms = item->reduced ? item->reduced->fullDecodeMs() : 0;
+			item->reduced.reset();
+			recognize_busy[worker] += clock.lap() - full_decode_ms;
+			full_decode_busy[worker] += full_decode_ms;
+			finished.push(std::move(item));
+		}
+	};
+
+	auto write = [&]()
+	{
+		// Results that overtook an earlier image wait here for it
+		std::map<size_t, std::unique_ptr<BatchItem>> waiting;
+		std::unique_ptr<BatchItem> item;
+		for (;;)
+		{
+			finished_depths.add(finished.size());
+			if (!finished.pop(item))
+			{
+				break;
+			}
+
+			StageClock clock;
+			size_t index = item->index;
+			waiting[index] = std::move(item);
+
+			size_t emitted = written;
+			for (auto first = waiting.begin(); first != waiting.end() && first->first == emitted; first = waiting.erase(first))
+			{
+				const BatchItem& done = *first->second;
+				out << "{\"image\":";
+				writeJsonString(out, paths[done.index]);
+				if (done.decoded)
+				{
+					report.cut_outlines += done.result.cut_outlines;
+					out << ",\"cards\":";
+					writeCardsJson(out, done.result);
+					if (results != nullptr)
+					{
+						results->write(done.index + 1, done.timestamp_us, done.result);
+					}
+				}
+				else
+				{
+					out << ",\"error\":\"cannot decode\"";
+					report.failed++;
+				}
+				out << "}\n";
+				emitted++;
+			}
+
+			if (emitted != written)
+			{
+				{
+					std::lock_guard<std::mutex> lock(order_mutex);
+					written = emitted;
+				}
+				order_changed.notify_all();
+			}
+			report.write.busy_ms += clock.lap();
+		}
+	};
+
+	std::vector<std::thread> readers;
+	for (int r = 0; r < report.read.threads; r++)
+	{
+		readers.emplace_back(read, r);
+	}
+	std::vector<std::thread> workers;
+	for (int w = 0; w < report.recognize.threads; w++)
+	{
+		workers.emplace_back(recognize, w);
+	}
+	std::thread writer(write);
+
+	// Every stage drains what the one before it left once that one is done
+	for (auto& thread: readers)
+	{
+		thread.join();
+	}
+	prefetch.close();
+	for (auto& thread: workers)
+	{
+		thread.join();
+	}
+	finished.close();
+	writer.join();
+	out.flush();
+
+	report.elapsed_ms = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+	for (double busy: read_busy)
+	{
+		report.read.busy_ms += busy;
+	}
+	for (double busy: recognize_busy)
+	{
+		report.recognize.busy_ms += busy;
+	}
+	if (options.reduction > 1)
+	{
+		report.full_decode.threads = report.recognize.threads;
+		for (double busy: full_decode_busy)
+		{
+			report.full_decode.busy_ms += busy;
+		}
+	}
+	report.prefetch = queueUsage(prefetch_depths, prefetch.capacity());
+	report.results = queueUsage({ finished_depths }, finished.capacity());
+	return report;
+}
+
+
+std::vector<std::string> loadImageList(const std::string& path)
+{
+	std::vector<std::string> paths;
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		std::cout << "Cannot open image list " << path << "\n";
+		return paths;
+	}
+
+	size_t slash = path.find_last_of("/\\");
+	std::string base = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		// Paths may contain spaces, only the line ends are trimmed
+		size_t first = line.find_first_not_of(" \t\r");
+		size_t last = line.find_last_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#')
+		{
+			continue;
+		}
+		std::string image = line.substr(first, last - first + 1);
+		paths.push_back(image[0] == '/' ? image : base + image);
+	}
+	return paths;
+}
@@ -0,0 +1,1151 @@
+#include "CardDetector.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#include "opencv2/imgcodecs.hpp"
+
+#include "opencv2/gapi.hpp"
+#include "opencv2/gapi/core.hpp"
+#include "opencv2/gapi/imgproc.hpp"
+
+// Only for the cached text renderer and the blend kernel, the implementation lives in main.cpp
+#define CVUI_DISABLE_COMPILATION_NOTICES
+#include "cvui.h"
+
+// Defined with the other glyph helpers below
+
+
+CardDetector::CardDetector(const std::string& template_dir)
+{
+	cv::Size rank_size(30, 45);
+	cv::Size suit_size(32, 36);
+
+	// Load rank and suit templates
+	std::vector<std::string> rank_names = {
+		"Ace", "Two", "Three", "Four", "Five", "Six",
+		"Seven", "Eight", "Nine", "Ten", "Jack", "Queen",
+		"King"
+	};
+
+	std::vector<std::pair<std::string, cv::Mat>> rank_images;
+	for (const auto& rank: rank_names)
+	{
+		rank_images.push_back({ rank, cv::imread(template_dir + rank + ".png", cv::IMREAD_GRAYSCALE) });
+
+		cv::Mat reference;
+		cv::resize(rank_images.back().second, reference, rank_size);
+		m_reference_ranks.push_back(reference);
+	}
+	m_rank_classifier.setTemplates(rank_images, rank_size);
+
+	std::vector<std::string> suit_names = {
+		"Hearts", "Clubs", "Spades", "Diamonds"
+	};
+
+	std::vector<std::pair<std::string, cv::Mat>> suit_images;
+	for (const auto& suit: suit_names)
+	{
+		uint32_t bit = 1u << suit_images.size();
+		(suit == "Hearts" || suit == "Diamonds" ? m_red_suits : m_black_suits) |= bit;
+		suit_images.push_back({ suit, cv::imread(template_dir + suit + ".png", cv::IMREAD_GRAYSCALE) });
+		m_reference_suits.push_back(suit_images.back().second);
+	}
+	m_suit_classifier.setTemplates(suit_images, suit_size);
+
+	m_card_img_data = {
+		{ "Warped", cv::Mat::zeros(10, 10, CV_8UC3) },
+		{ "Rank", cv::Mat::zeros(10, 10, CV_8UC1)},
+		{ "Rank Thresholded", cv::Mat::zeros(10, 10, CV_8UC1)},
+		{ "Rank Dilated", cv::Mat::zeros(10, 10, CV_8UC1)},
+		{ "Rank Contours", cv::Mat::zeros(10, 10, CV_8UC3)},
+		{ "Rank Bounded", cv::Mat::zeros(10, 10, CV_8UC1)},
+		{ "Rank Final", cv::Mat::zeros(10, 10, CV_8UC1)},
+		{ "Suit", cv::Mat::zeros(10, 10, CV_8UC1)},
+		{ "Suit Thresholded", cv::Mat::zeros(10, 10, CV_8UC1)},
+		{ "Suit Eroded", cv::Mat::zeros(10, 10, CV_8UC1)},
+		{ "Suit Dilated", cv::Mat::zeros(10, 10, CV_8UC1)},
+		{ "Suit Countours", cv::Mat::zeros(10, 10, CV_8UC3)},
+		{ "Suit Bounded", cv::Mat::zeros(10, 10, CV_8UC1)}
+	};
+}
+
+
+// Index boxes of a card warped to 250x350
+static const cv::Size CARD_SIZE(250, 350);
+static const cv::Rect RANK_BOX(0, 0, 35, 55);
+static const cv::Rect SUIT_BOX(0, 55, 35, 45);
+
+// Both index boxes, the part of a card recognition looks at
+static const cv::Rect INDEX_BOX(0, 0, 35, 100);
+
+// Corners that moved less than this keep their homography and remap tables
+static const float WARP_TOLERANCE = 0.25f;
+
+// Boxes are stacked in the glyph batches with empty rows in between, enough that the
+// rank dilation, which reaches two rows up and one down, never carries ink across
+static const int GLYPH_GAP = 2;
+
+// Resolution of the index boxes when a doubtful card is looked at again
+static const int VERIFY_SCALE = 2;
+
+// Source pixels across the rank box that reduced images must still offer, the narrowest
+// cards of ground-truth.txt (70 pixels wide in cards-numerous.jpg) have ten
+static const int MIN_RANK_BOX_PIXELS = 10;
+
+
+// Cards warped from the BGR frame rather than its gray copy are converted once warped
+static void toGray(cv::Mat& image)
+{
+	if (image.channels() == 3)
+	{
+		cv::cvtColor(image, image, cv::COLOR_BGR2GRAY);
+	}
+}
+
+
+// One index box of a card at `scale` times the usual resolution, upside_down takes it from the opposite corner
+static cv::Mat warpBox(const cv::Mat& gray, const cv::Mat& homography, cv::Rect box, int scale, bool upside_down)
+{
+	if (upside_down)
+	{
+		box = cv::Rect(CARD_SIZE.width - box.br().x, CARD_SIZE.height - box.br().y, box.width, box.height);
+	}
+
+	cv::Mat to_box = cv::Mat::eye(3, 3, CV_64F);
+	to_box.at<double>(0, 0) = to_box.at<double>(1, 1) = scale;
+	to_box.at<double>(0, 2) = -box.x * scale;
+	to_box.at<double>(1, 2) = -box.y * scale;
+
+	cv::Mat patch;
+	cv::warpPerspective(gray, patch, to_box * homography, cv::Size(box.width * scale, box.height * scale));
+	toGray(patch);
+	if (upside_down)
+	{
+		cv::flip(patch, patch, -1);
+	}
+	return patch;
+}
+
+
+// Bounding box of the largest blob of a binary image
+static cv::Rect largestBlob(const cv::Mat& binary)
+{
+	std::vector<std::vector<cv::Point>> contours;
+	cv::findContours(binary, contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+
+	double max_area = 0;
+	cv::Rect bounds;
+	for (const auto& c: contours)
+	{
+		double area = cv::contourArea(c);
+		if (area > max_area)
+		{
+			max_area = area;
+			bounds = cv::boundingRect(c);
+		}
+	}
+	return bounds;
+}
+
+
+// The rank and suit glyphs of an index box the way the main pass extracts them, dark on light
+static cv::Mat rankGlyph(const cv::Mat& rank_image, int scale)
+{
+	cv::Mat thresholded, dilated;
+	cv::threshold(rank_image, thresholded, 150, 255, cv::THRESH_OTSU);
+	cv::dilate(cv::Mat(~thresholded), dilated, cv::getStructuringElement(cv::MORPH_CROSS, cv::Size(4 * scale, 4 * scale)));
+
+	cv::Rect bounds = largestBlob(dilated);
+	return bounds.empty() ? cv::Mat(rank_image.size(), CV_8UC1, cv::Scalar(255)) : cv::Mat(~dilated(bounds));
+}
+
+
+static cv::Mat suitGlyph(const cv::Mat& suit_image)
+{
+	cv::Mat thresholded;
+	cv::threshold(suit_image, thresholded, 120, 255, cv::THRESH_OTSU);
+	cv::Mat inverted = ~thresholded;
+
+	cv::Rect bounds = largestBlob(inverted);
+	return bounds.empty() ? thresholded : cv::Mat(~inverted(bounds));
+}
+
+
+// Batch holding an index box of `count` cards
+static cv::Size glyphBatchSize(const cv::Rect& box, int count)
+{
+	return cv::Size(box.width, GLYPH_GAP + count * (box.height + GLYPH_GAP));
+}
+
+
+// The box of card i in a glyph batch
+static cv::Mat glyphBox(const cv::Mat& batch, const cv::Rect& box, int i)
+{
+	int top = GLYPH_GAP + i * (box.height + GLYPH_GAP);
+	return batch.rowRange(top, top + box.height);
+}
+
+
+// Threshold cv::threshold picks with THRESH_OTSU for a 256 bin histogram
+static int otsuThreshold(const int* histogram, int total)
+{
+	const double epsilon = std::numeric_limits<float>::epsilon();
+
+	double mu = 0;
+	for (int i = 0; i < 256; i++)
+	{
+		mu += i * (double)histogram[i];
+	}
+	mu /= total;
+
+	double q1 = 0;
+	double mu1 = 0;
+	double max_sigma = 0;
+	int threshold = 0;
+	for (int i = 0; i < 256; i++)
+	{
+		double p = (double)histogram[i] / total;
+		mu1 *= q1;
+		q1 += p;
+		double q2 = 1 - q1;
+		if (std::min(q1, q2) < epsilon || std::max(q1, q2) > 1 - epsilon)
+		{
+			continue;
+		}
+
+		mu1 = (mu1 + i * p) / q1;
+		double mu2 = (mu - q1 * mu1) / q2;
+		double sigma = q1 * q2 * (mu1 - mu2) * (mu1 - mu2);
+		if (sigma > max_sigma)
+		{
+			max_sigma = sigma;
+			threshold = i;
+		}
+	}
+	return threshold;
+}
+
+
+// Otsu thresholds the rank and suit box of every stacked index strip into the glyph batches, ink becomes 255.
+// The boxes span whole rows of continuous buffers, so each one is a single run of pixels.
+static void thresholdIndexes(const cv::Mat& strips, int count, cv::Mat& rank_binary, cv::Mat& suit_binary)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	CV_Assert(strips.isContinuous() && rank_binary.isContinuous() && suit_binary.isContinuous());
+	CV_Assert(RANK_BOX.width == INDEX_BOX.width && SUIT_BOX.width == INDEX_BOX.width);
+
+	// Only the gaps need it, the boxes are overwritten below
+	rank_binary.setTo(0);
+	suit_binary.setTo(0);
+
+	int histogram[256];
+	for (int i = 0; i < count; i++)
+	{
+		for (bool rank: { true, false })
+		{
+			const cv::Rect& box = rank ? RANK_BOX : SUIT_BOX;
+			const uchar* pixels = strips.ptr<uchar>(i * INDEX_BOX.height + box.y);
+			const int size = box.area();
+
+			std::fill(histogram, histogram + 256, 0);
+			for (int p = 0; p < size; p++)
+			{
+				histogram[pixels[p]]++;
+			}
+			const uchar threshold = (uchar)otsuThreshold(histogram, size);
+
+			uchar* ink = glyphBox(rank ? rank_binary : suit_binary, box, i).ptr<uchar>();
+			for (int p = 0; p < size; p++)
+			{
+				ink[p] = pixels[p] <= threshold ? 255 : 0;
+			}
+		}
+	}
+}
+
+
+GlyphClassifier::Match CardDetector::verify(GlyphClassifier& classifier, const cv::Mat& gray, const cv::Mat& homography, bool rank)
+{
+	// Both corners at double resolution against every template, their scores summed
+	m_verify_totals.assign(classifier.templateCount(), 0);
+	for (bool upside_down: { false, true })
+	{
+		cv::Mat box = warpBox(gray, homography, rank ? RANK_BOX : SUIT_BOX, VERIFY_SCALE, upside_down);
+		classifier.scoreAll(rank ? rankGlyph(box, VERIFY_SCALE) : suitGlyph(box), m_verify_scores);
+		for (size_t t = 0; t < m_verify_scores.size(); t++)
+		{
+			// Halved so scores and margins stay on the scale of a single corner
+			m_verify_totals[t] += m_verify_scores[t] / 2;
+		}
+	}
+	return classifier.bestOf(m_verify_totals);
+}
+
+
+const CardDetector::CachedWarp& CardDetector::cachedWarp(const std::vector<cv::Point2f>& corners, const std::vector<cv::Point2f>& target, DetectionResult& result)
+{
+	// A card that did not move since the last frame keeps its homography and tables
+	for (auto& cached: m_warp_cache)
+	{
+		bool same = !cached.corners.empty();
+		for (size_t i = 0; i < corners.size() && same; i++)
+		{
+			cv::Point2f delta = corners[i] - cached.corners[i];
+			same = std::abs(delta.x) <= WARP_TOLERANCE && std::abs(delta.y) <= WARP_TOLERANCE;
+		}
+		if (same)
+		{
+			m_warp_cache_next.push_back(std::move(cached));
+			cached.corners.clear();
+			result.warps_reused++;
+			return m_warp_cache_next.back();
+		}
+	}
+
+	CachedWarp warp;
+	warp.corners = corners;
+	warp.homography = cv::getPerspectiveTransform(corners, target);
+
+	// Source position of every pixel of the index strip, as cv::warpPerspective would compute it
+	cv::Mat inverse = warp.homography.inv();
+	const double* h = inverse.ptr<double>();
+	cv::Mat map(INDEX_BOX.size(), CV_32FC2);
+	for (int y = 0; y < map.rows; y++)
+	{
+		cv::Vec2f* row = map.ptr<cv::Vec2f>(y);
+		for (int x = 0; x < map.cols; x++)
+		{
+			double u = x + INDEX_BOX.x, v = y + INDEX_BOX.y;
+			double w = h[6] * u + h[7] * v + h[8];
+			w = w != 0 ? 1 / w : 0;
+			row[x] = cv::Vec2f(float((h[0] * u + h[1] * v + h[2]) * w), float((h[3] * u + h[4] * v + h[5]) * w));
+		}
+	}
+	cv::convertMaps(map, cv::noArray(), warp.map_xy, warp.map_frac, CV_16SC2);
+
+	m_warp_cache_next.push_back(std::move(warp));
+	return m_warp_cache_next.back();
+}
+
+
+enum InkColor
+{
+	INK_UNKNOWN,
+	INK_RED,
+	INK_BLACK
+};
+
+
+// Color of the pixels set in the ink mask of a glyph, looked up in the BGR frame through the card's homography
+static InkColor inkColor(const cv::Mat& color, const cv::Mat& homography, const cv::Rect& area, const cv::Mat& ink_mask)
+{
+	if (color.empty())
+	{
+		return INK_UNKNOWN;
+	}
+
+	// Only the glyph's box is warped, the shift puts it at the origin
+	cv::Mat shift = cv::Mat::eye(3, 3, CV_64F);
+	shift.at<double>(0, 2) = -area.x;
+	shift.at<double>(1, 2) = -area.y;
+	cv::Mat patch;
+	cv::warpPerspective(color, patch, shift * homography, area.size());
+
+	int count = 0;
+	int redness = 0;
+	int chroma = 0;
+	for (int y = 0; y < patch.rows; y++)
+	{
+		const cv::Vec3b* pixel = patch.ptr<cv::Vec3b>(y);
+		const uchar* ink = ink_mask.ptr<uchar>(y);
+		for (int x = 0; x < patch.cols; x++)
+		{
+			if (ink[x] == 0)
+			{
+				continue;
+			}
+			int b = pixel[x][0], g = pixel[x][1], r = pixel[x][2];
+			redness += r - std::max(g, b);
+			chroma += std::max(r, std::max(g, b)) - std::min(r, std::min(g, b));
+			count++;
+		}
+	}
+
+	// Too little ink to tell, or a tint that is neither, e.g. under colored light
+	if (count < 10)
+	{
+		return INK_UNKNOWN;
+	}
+	if (redness > 40 * count)
+	{
+		return INK_RED;
+	}
+	return chroma < 25 * count ? INK_BLACK : INK_UNKNOWN;
+}
+
+
+// Smallest outline area in pixels taken for a card
+static const double MIN_CARD_AREA = 5000;
+
+
+// Outline of a card when the contour has one, a quadrilateral large enough to be a card
+static bool approximateQuad(const std::vector<cv::Point>& contour, std::vector<cv::Point2f>& quad, double min_area = MIN_CARD_AREA)
+{
+	float e = 0.01 * cv::arcLength(contour, true);
+	cv::approxPolyDP(contour, quad, e, true);
+	return quad.size() == 4 && cv::contourArea(quad) >= min_area;
+}
+
+
+static void resetResult(DetectionResult& result)
+{
+	result.card_data.clear();
+	result.cards.clear();
+	result.bytes_copied = 0;
+	result.reverified = 0;
+	result.warps_reused = 0;
+	result.cut_outlines = 0;
+	result.disagreements = 0;
+	result.timings = StageTimings();
+}
+
+
+// The per card matcher the batched classifier replaced: every allowed template resized to the
+// glyph, absdiff and sum, the first of equal sums wins
+static int referenceLabel(const cv::Mat& glyph, const std::vector<cv::Mat>& templates, uint32_t allowed)
+{
+	uint32_t all = templates.size() >= 32 ? GlyphClassifier::ALL_TEMPLATES : (1u << templates.size()) - 1;
+	allowed = (allowed & all) != 0 ? allowed & all : all;
+
+	int label = -1;
+	int min_diff = std::numeric_limits<int>::max();
+	cv::Mat tem, diff_image;
+	for (size_t t = 0; t < templates.size(); t++)
+	{
+		if (!(allowed & (1u << t)))
+		{
+			continue;
+		}
+		cv::resize(templates[t], tem, glyph.size());
+		cv::absdiff(glyph, tem, diff_image);
+		int diff = (int)(cv::sum(diff_image)[0] / 255);
+		if (diff < min_diff)
+		{
+			min_diff = diff;
+			label = (int)t;
+		}
+	}
+	return label;
+}
+
+
+void CardDetector::drawOutput(const cv::Mat& color, DetectionResult& result)
+{
+	// The only stage that draws over the input frame, so the only copy of it
+	cv::Mat& cards_color = m_output.next(color.size(), color.type());
+	color.copyTo(cards_color);
+	result.bytes_copied += byteSize(cards_color);
+
+	// Translucent highlight over every card, blended in place through a mask of its outline
+	m_highlight_mask.create(cards_color.size(), CV_8UC1);
+	for (const auto& card: result.cards)
+	{
+		const std::vector<cv::Point>& quad = card.quad;
+		cv::Rect bounds = cv::boundingRect(quad) & cv::Rect(0, 0, cards_color.cols, cards_color.rows);
+		if (bounds.area() <= 0)
+		{
+			continue;
+		}
+
+		std::vector<cv::Point> local_quad;
+		for (const auto& p: quad)
+		{
+			local_quad.push_back(p - bounds.tl());
+		}
+
+		cv::Mat mask = m_highlight_mask(bounds);
+		mask.setTo(0);
+		cv::fillConvexPoly(mask, local_quad, cv::Scalar(255));
+		cvui::blendRect(cards_color, bounds, cv::Scalar(0, 0, 255), 0.2, mask);
+	}
+
+	for (const auto& card: result.cards)
+	{
+		cv::polylines(cards_color, card.quad, true, cv::Scalar(0, 0, 255), 2);
+	}
+
+	result.pipe_out["Output"] = cards_color;
+
+	// Draw best match rank and suit at center of image
+	for (const auto& card: result.cards)
+	{
+		auto mid = card.midpoint;
+		std::string rank_best_guess = card.rank;
+		std::string suit_best_guess = card.suit;
+
+		cv::Size rank_size = cv::getTextSize(rank_best_guess, cv::FONT_HERSHEY_COMPLEX, 1, 2, nullptr);
+		cv::Point rank_origin = cv::Point(mid.x - rank_size.width / 2, mid.y + rank_size.height / 2);
+
+		cv::Size suit_size = cv::getTextSize(suit_best_guess, cv::FONT_HERSHEY_COMPLEX, 0.75, 2, nullptr);
+		cv::Point suit_origin = cv::Point(mid.x - suit_size.width / 2, mid.y + suit_size.height / 2);
+
+		// Labels repeat from frame to frame, blend them from the rasterized text cache
+		cvui::putTextCached(cards_color, rank_best_guess, rank_origin, cv::FONT_HERSHEY_COMPLEX, 1.0, CV_RGB(0, 0, 255), 2);
+		cvui::putTextCached(cards_color, suit_best_guess, suit_origin + cv::Point(0, 24), cv::FONT_HERSHEY_COMPLEX, 0.75, CV_RGB(0, 0, 255), 2);
+	}
+}
+
+
+cv::GCompiled& CardDetector::frontEnd(const cv::Mat& gray)
+{
+	cv::GMatDesc desc = cv::descr_of(gray);
+	if (m_front_end && desc == m_front_end_desc && stage_images == m_front_end_stages
+		&& gauss_params.kernel_size == m_front_end_gauss.kernel_size && gauss_params.sigma == m_front_end_gauss.sigma
+		&& canny_params.low_threshold == m_front_end_canny.low_threshold && canny_params.high_threshold == m_front_end_canny.high_threshold)
+	{
+		return m_front_end;
+	}
+
+	// The parameters are constants of the graph, tuning them compiles it again
+	cv::GMat g_in;
+	cv::GMat g_blurred = cv::gapi::gaussianBlur(g_in, { gauss_params.kernel_size, gauss_params.kernel_size }, gauss_params.sigma);
+	cv::GMat g_edges = cv::gapi::Canny(g_blurred, canny_params.low_threshold, canny_params.high_threshold);
+	cv::GArray<cv::GArray<cv::Point>> g_contours = cv::gapi::findContours(g_edges, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+
+	if (stage_images)
+	{
+		cv::GMat g_equalized = cv::gapi::equalizeHist(g_blurred);
+		cv::GComputation pipeline(cv::GIn(g_in), cv::GOut(g_blurred, g_equalized, g_edges, g_contours));
+		m_front_end = pipeline.compile(desc);
+	}
+	else
+	{
+		cv::GComputation pipeline(cv::GIn(g_in), cv::GOut(g_contours));
+		m_front_end = pipeline.compile(desc);
+	}
+
+	m_front_end_desc = desc;
+	m_front_end_gauss = gauss_params;
+	m_front_end_canny = canny_params;
+	m_front_end_stages = stage_images;
+	return m_front_end;
+}
+
+
+void CardDetector::process(const cv::Mat& color, DetectionResult& result)
+{
+	auto& pipe_out = result.pipe_out;
+	resetResult(result);
+
+	StageClock clock;
+	cv::Mat& cards = m_gray.next(color.size(), CV_8UC1);
+	cv::cvtColor(color, cards, cv::COLOR_BGR2GRAY);
+
+	// Execute pipeline
+	cv::GCompiled& pipeline = frontEnd(cards);
+	std::vector<std::vector<cv::Point>> contours;
+	if (stage_images)
+	{
+		pipe_out["Source"] = cards;
+		pipeline(
+			cv::gin(cards),
+			cv::gout
+			(
+				pipe_out["Blurred"],
+				pipe_out["Equalized"],
+				pipe_out["Edges"],
+				contours
+			)
+		);
+	}
+	else
+	{
+		pipeline(cv::gin(cards), cv::gout(contours));
+	}
+
+	result.timings.ms[STAGE_FRONT_END] = clock.lap();
+
+	recognize(color, cards, contours, clock, result);
+	if (!stage_images)
+	{
+		return;
+	}
+
+	// Generate original contour overlay
+	cv::Mat& contour_base = m_contours.next(cards.size(), CV_8UC3);
+	cv::cvtColor(cards, contour_base, cv::COLOR_GRAY2BGR);
+
+	for (size_t i = 0; i < contours.size(); i++)
+	{
+		cv::drawContours(contour_base, contours, i, cv::Scalar(0, 0, 255), 4);
+	}
+	pipe_out["Contours"] = contour_base;
+
+	// Generate rectangle contour
+	std::vector<std::vector<cv::Point>> rect_contours = {};
+	for (const auto& card: result.cards)
+	{
+		rect_contours.push_back(card.quad);
+	}
+
+	cv::Mat& rect_contour_base = m_rect_contours.next(cards.size(), CV_8UC3);
+	cv::cvtColor(cards, rect_contour_base, cv::COLOR_GRAY2BGR);
+
+	for (size_t i = 0; i < rect_contours.size(); i++)
+	{
+		cv::drawContours(rect_contour_base, rect_contours, i, cv::Scalar(0, 0, 255), 2);
+
+	}
+	pipe_out["Rectangle Contours"] = rect_contour_base;
+
+	drawOutput(color, result);
+	result.timings.ms[STAGE_OVERLAY] = clock.lap();
+}
+
+
+void CardDetector::recognize(const cv::Mat& color, const cv::Mat& cards, const std::vector<std::vector<cv::Point>>& contours, StageClock& clock,
+	DetectionResult& result, int scale)
+{
+	auto& card_data = result.card_data;
+
+	std::vector<cv::Mat> card_images = {};
+	std::vector<cv::Mat> homographies;
+	std::vector<std::pair<cv::Mat, cv::Mat>> index_maps;
+	double warp_ms = 0;
+	std::vector<cv::Point2f> target_pts = {{0, 0}, {0, 349}, {249, 349}, {249, 0}};
+
+	for (auto& c: contours)
+	{
+		std::vector<cv::Point2f> output;
+		std::vector<cv::Point> output_i;
+
+		if (!approximateQuad(c, output, MIN_CARD_AREA / (scale * scale))) {
+			continue;
+		}
+
+		float x_sum = 0;
+		float y_sum = 0;
+		for (auto p: output)
+		{
+			output_i.push_back(cv::Point((int)p.x, (int)p.y));
+
+			x_sum += p.x;
+			y_sum += p.y;
+		}
+		cv::Point2f mid(x_sum / 4, y_sum / 4);
+
+		CardResult card;
+		card.quad = output_i;
+		card.midpoint = mid * (float)scale;
+		for (auto& p: card.quad)
+		{
+			p *= scale;
+		}
+		result.cards.push_back(card);
+
+		// Determine semantic location of this point in image
+		std::vector<cv::Point2f> src(4);
+		for (auto p: output)
+		{
+			cv::Point2f delta = mid - p;
+
+			if (delta.x > 0 && delta.y > 0)
+			{
+				// Top left
+				src[0] = p;
+			}
+			else if (delta.x < 0 && delta.y > 0)
+			{
+				// Top right
+				src[3] = p;
+			}
+			else if (delta.x > 0 && delta.y < 0)
+			{
+				// Bottom left
+				src[1] = p;
+			}
+			else
+			{
+				// Bottom right
+				src[2] = p;
+			}
+		}
+
+		StageClock warp_clock;
+		const CachedWarp& warp = cachedWarp(src, target_pts, result);
+		homographies.push_back(warp.homography);
+		index_maps.push_back({ warp.map_xy, warp.map_frac });
+
+		if (card_views)
+		{
+			cv::Mat img;
+			cv::warpPerspective(cards, img, warp.homography, CARD_SIZE);
+			toGray(img);
+			card_images.push_back(img);
+		}
+		warp_ms += warp_clock.lap();
+	}
+	m_warp_cache.swap(m_warp_cache_next);
+	m_warp_cache_next.clear();
+
+	// Recognition only needs the index strips, gathered through the fixed-point tables into one stacked buffer
+	StageClock gather_clock;
+	int card_count = (int)result.cards.size();
+	cv::Mat& strips = m_index_strips.next(cv::Size(INDEX_BOX.width, card_count * INDEX_BOX.height), CV_8UC1);
+	for (int i = 0; i < card_count; i++)
+	{
+		cv::Mat strip = strips.rowRange(i * INDEX_BOX.height, (i + 1) * INDEX_BOX.height);
+		if (cards.channels() == 3)
+		{
+			cv::remap(cards, m_color_strip, index_maps[i].first, index_maps[i].second, cv::INTER_LINEAR);
+			cv::cvtColor(m_color_strip, strip, cv::COLOR_BGR2GRAY);
+		}
+		else
+		{
+			cv::remap(cards, strip, index_maps[i].first, index_maps[i].second, cv::INTER_LINEAR);
+		}
+	}
+	warp_ms += gather_clock.lap();
+	result.timings.ms[STAGE_WARP] = warp_ms;
+	result.timings.ms[STAGE_QUAD_FILTER] = clock.lap() - warp_ms;
+
+	// Threshold every index box and dilate every rank in one go, counted with the ranks
+	cv::Mat& rank_binary = m_rank_binary.next(glyphBatchSize(RANK_BOX, card_count), CV_8UC1);
+	cv::Mat& suit_binary = m_suit_binary.next(glyphBatchSize(SUIT_BOX, card_count), CV_8UC1);
+	thresholdIndexes(strips, card_count, rank_binary, suit_binary);
+
+	cv::Mat& rank_dilated_batch = m_rank_dilated.next(rank_binary.size(), CV_8UC1);
+	cv::dilate(rank_binary, rank_dilated_batch, cv::getStructuringElement(cv::MORPH_CROSS, cv::Size(4, 4)));
+	result.timings.ms[STAGE_RANK_MATCH] += clock.lap();
+
+	// Extract the rank and suit glyphs of every card
+	std::vector<int> rank_references;
+	std::vector<int> suit_references;
+	m_rank_classifier.clear();
+	m_suit_classifier.clear();
+	for (int i = 0; i < card_count; i++)
+	{
+		// Initialize card data for viewer
+		card_data.push_back(m_card_img_data);
+
+		auto& card_map = card_data[i];
+		cv::Mat strip = strips.rowRange(i * INDEX_BOX.height, (i + 1) * INDEX_BOX.height);
+
+		// Extract + Identify Rank
+		cv::Mat rank_image = strip(RANK_BOX);
+		card_map["Rank"] = rank_image;
+
+		cv::Mat rank_dilated = glyphBox(rank_dilated_batch, RANK_BOX, i);
+		std::vector<std::vector<cv::Point>> rank_contours;
+		cv::findContours(rank_dilated, rank_contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+
+		// Select largest contour
+		std::vector<cv::Point> largest_c;
+		float max_area = 0;
+		for (auto& c: rank_contours)
+		{
+			float area = cv::contourArea(c);
+			if (area > max_area)
+			{
+				max_area = area;
+				largest_c = c;
+			}
+		}
+
+		if (card_views)
+		{
+			card_map["Rank Threshold"] = cv::Mat(~glyphBox(rank_binary, RANK_BOX, i));
+			card_map["Rank Dilated"] = cv::Mat(~rank_dilated);
+
+			// Draw contours
+			cv::Mat rank_contour_base;
+			cv::cvtColor(~rank_dilated, rank_contour_base, cv::COLOR_GRAY2BGR);
+			for (size_t c = 0; c < rank_contours.size(); c++)
+			{
+				cv::drawContours(rank_contour_base, rank_contours, c, { 255, 0, 0 }, 1);
+			}
+			card_map["Rank Contours"] = rank_contour_base;
+		}
+
+		// Bounding box of the largest contour, dark on light like the templates
+		cv::Mat rank_identity(rank_image.size(), CV_8UC1, cv::Scalar(255));
+		if (!largest_c.empty())
+		{
+			rank_identity = ~rank_dilated(cv::boundingRect(largest_c));
+		}
+		card_map["Rank Bounded"] = rank_identity;
+		card_map["Rank Final"] = rank_identity;
+
+		// Matched together with the glyphs of all other cards once they are extracted
+		m_rank_classifier.add(rank_identity);
+		if (cross_check)
+		{
+			rank_references.push_back(referenceLabel(rank_identity, m_reference_ranks, GlyphClassifier::ALL_TEMPLATES));
+		}
+		result.timings.ms[STAGE_RANK_MATCH] += clock.lap();
+
+		// Draw bounding boxes on card, without the whole card the viewer gets the index strip
+		if (card_views)
+		{
+			cv::Mat card_img_color;
+			cv::cvtColor(card_images[i], card_img_color, cv::COLOR_GRAY2BGR);
+			cv::rectangle(card_img_color, RANK_BOX, CV_RGB(0, 0, 255), 1);
+			cv::rectangle(card_img_color, SUIT_BOX, CV_RGB(0, 255, 0), 1);
+			card_map["Warped"] = card_img_color;
+		}
+		else
+		{
+			card_map["Warped"] = strip;
+		}
+
+		// Extract + Identify Suit
+		cv::Mat suit_image = strip(SUIT_BOX);
+		card_map["Suit"] = suit_image;
+
+		cv::Mat suit_inverted = glyphBox(suit_binary, SUIT_BOX, i);
+		std::vector<std::vector<cv::Point>> suit_contours;
+		cv::findContours(suit_inverted, suit_contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+
+		// Calculate bb of largest area contour
+		cv::Rect suit_bb;
+		{
+			std::vector<cv::Point> largest_contour;
+
+			float max_area = 0;
+			for (auto& c : suit_contours)
+			{
+				float area = cv::contourArea(c);
+				if (area > max_area)
+				{
+					max_area = area;
+					largest_contour = c;
+				}
+			}
+			suit_bb = cv::boundingRect(largest_contour);
+		}
+
+		if (card_views)
+		{
+			cv::Mat suit_thresholded = ~suit_inverted;
+			card_map["Suit Threshold"] = suit_thresholded;
+			card_map["Suit Dilated"] = suit_thresholded;
+			card_map["Suit Eroded"] = suit_thresholded;
+
+			// Draw suit contours
+			cv::Mat suit_contour_img;
+			cv::cvtColor(suit_thresholded, suit_contour_img, cv::COLOR_GRAY2BGR);
+			for (size_t c = 0; c < suit_contours.size(); c++)
+			{
+				cv::drawContours(suit_contour_img, suit_contours, c, { 255, 0, 0 }, 1);
+			}
+			card_map["Suit Contours"] = suit_contour_img;
+		}
+
+		// Final suit
+		cv::Mat bounded_suit = suit_bb.empty() ? cv::Mat(~suit_inverted) : cv::Mat(~suit_inverted(suit_bb));
+		card_map["Suit Bounded"] = bounded_suit;
+
+		// Red ink leaves only Hearts and Diamonds to compare, black ink Clubs and Spades
+		uint32_t allowed = GlyphClassifier::ALL_TEMPLATES;
+		switch (inkColor(color, homographies[i], SUIT_BOX, suit_inverted))
+		{
+		case INK_RED:
+			allowed = m_red_suits;
+			break;
+		case INK_BLACK:
+			allowed = m_black_suits;
+			break;
+		default:
+			break;
+		}
+		m_suit_classifier.add(bounded_suit, allowed);
+		if (cross_check)
+		{
+			// Color is ruled out the same way, only the scoring is compared
+			suit_references.push_back(referenceLabel(bounded_suit, m_reference_suits, allowed));
+		}
+		result.timings.ms[STAGE_SUIT_MATCH] += clock.lap();
+	}
+
+	// A card whose middle lies inside a card of the previous frame is most likely still that card
+	m_rank_hints.assign(result.cards.size(), -1);
+	m_suit_hints.assign(result.cards.size(), -1);
+	for (size_t i = 0; i < result.cards.size(); i++)
+	{
+		for (const auto& tracked: m_tracked)
+		{
+			if (cv::pointPolygonTest(tracked.quad, result.cards[i].midpoint, false) >= 0)
+			{
+				m_rank_hints[i] = tracked.rank_label;
+				m_suit_hints[i] = tracked.suit_label;
+				break;
+			}
+		}
+	}
+
+	// Identify the ranks and suits of all cards, new cards with one matrix product each
+	// Doubtful cards are looked at again the expensive way, confident ones keep the cheap answer
+	m_rank_classifier.classify(m_rank_matches, m_rank_hints);
+	result.rank_stats = m_rank_classifier.stats();
+	for (size_t i = 0; i < m_rank_matches.size(); i++)
+	{
+		if (cross_check && m_rank_matches[i].label != rank_references[i])
+		{
+			result.disagreements++;
+		}
+		if (m_rank_matches[i].confidence < verify_below)
+		{
+			m_rank_matches[i] = verify(m_rank_classifier, cards, homographies[i], true);
+			result.reverified++;
+		}
+		result.cards[i].rank = m_rank_classifier.name(m_rank_matches[i].label);
+		result.cards[i].rank_score = m_rank_matches[i].score;
+		result.cards[i].rank_confidence = m_rank_matches[i].confidence;
+	}
+	result.timings.ms[STAGE_RANK_MATCH] += clock.lap();
+
+	m_suit_classifier.classify(m_suit_matches, m_suit_hints);
+	result.suit_stats = m_suit_classifier.stats();
+	for (size_t i = 0; i < m_suit_matches.size(); i++)
+	{
+		if (cross_check && m_suit_matches[i].label != suit_references[i])
+		{
+			result.disagreements++;
+		}
+		if (m_suit_matches[i].confidence < verify_below)
+		{
+			m_suit_matches[i] = verify(m_suit_classifier, cards, homographies[i], false);
+			result.reverified++;
+		}
+		result.cards[i].suit = m_suit_classifier.name(m_suit_matches[i].label);
+		result.cards[i].suit_score = m_suit_matches[i].score;
+		result.cards[i].suit_confidence = m_suit_matches[i].confidence;
+	}
+
+	m_tracked.clear();
+	for (size_t i = 0; i < result.cards.size(); i++)
+	{
+		m_tracked.push_back({ result.cards[i].quad, m_rank_matches[i].label, m_suit_matches[i].label });
+	}
+	result.timings.ms[STAGE_SUIT_MATCH] += clock.lap();
+}
+
+
+// Overlapping tiles covering the frame, in rows from the top left
+static std::vector<cv::Rect> tileGrid(cv::Size frame, const TileOptions& options)
+{
+	// An overlap close to the tile size would make the step, and with it the tile count, explode
+	std::vector<cv::Rect> tiles;
+	int step = options.tile_size - std::min(std::max(0, options.overlap), options.tile_size / 2);
+	for (int y = 0; y < frame.height; y += step)
+	{
+		for (int x = 0; x < frame.width; x += step)
+		{
+			tiles.push_back(cv::Rect(x, y, options.tile_size, options.tile_size) & cv::Rect(cv::Point(0, 0), frame));
+			if (x + options.tile_size >= frame.width)
+			{
+				break;
+			}
+		}
+		if (y + options.tile_size >= frame.height)
+		{
+			break;
+		}
+	}
+	return tiles;
+}
+
+
+// Card outlines the front end finds in one tile, in frame coordinates. An outline touching a
+// border the tile shares with another one may be cut off there, it is left to the other tile,
+// its bounds go to cut when it is large enough to be part of a card.
+static void findTileQuads(const cv::Mat& gray, const cv::Rect& tile, const GaussianParameters& gauss, const CannyParameters& canny,
+	double min_area, std::vector<std::vector<cv::Point>>& quads, std::vector<cv::Rect>* cut = nullptr)
+{
+	// Filtering a view reads the pixels around the tile, the frame border is only where the frame ends
+	cv::Mat blurred, edges;
+	cv::GaussianBlur(gray(tile), blurred, { gauss.kernel_size, gauss.kernel_size }, gauss.sigma);
+	cv::Canny(blurred, edges, canny.low_threshold, canny.high_threshold);
+
+	std::vector<std::vector<cv::Point>> contours;
+	cv::findContours(edges, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+
+	int left = tile.x > 0 ? 1 : 0;
+	int top = tile.y > 0 ? 1 : 0;
+	int right = tile.br().x < gray.cols ? tile.width - 1 : tile.width;
+	int bottom = tile.br().y < gray.rows ? tile.height - 1 : tile.height;
+	cv::Rect inner(left, top, right - left, bottom - top);
+
+	std::vector<cv::Point2f> quad;
+	for (const auto& contour: contours)
+	{
+		cv::Rect bounds = cv::boundingRect(contour);
+		if ((bounds & inner) != bounds)
+		{
+			if (cut != nullptr && bounds.area() >= min_area)
+			{
+				cut->push_back(bounds + tile.tl());
+			}
+			continue;
+		}
+		if (!approximateQuad(contour, quad, min_area))
+		{
+			continue;
+		}
+
+		std::vector<cv::Point> shifted;
+		for (const auto& p: quad)
+		{
+			shifted.push_back(cv::Point((int)p.x, (int)p.y) + tile.tl());
+		}
+		quads.push_back(shifted);
+	}
+}
+
+
+void CardDetector::processTiled(const cv::Mat& color, const TileOptions& options, DetectionResult& result)
+{
+	if (options.tile_size <= 0 || (color.cols <= options.tile_size && color.rows <= options.tile_size))
+	{
+		process(color, result);
+		return;
+	}
+
+	result.pipe_out.clear();
+	resetResult(result);
+
+	StageClock clock;
+	cv::Mat& cards = m_gray.next(color.size(), CV_8UC1);
+	cv::cvtColor(color, cards, cv::COLOR_BGR2GRAY);
+
+	// Each thread filters one tile at a time with its own tile sized buffers
+	std::vector<cv::Rect> tiles = tileGrid(color.size(), options);
+	std::vector<std::vector<std::vector<cv::Point>>> tile_quads(tiles.size());
+	std::vector<std::vector<cv::Rect>> tile_cuts(tiles.size());
+	std::atomic<size_t> next(0);
+	auto work = [&]()
+	{
+		size_t i;
+		while ((i = next++) < tiles.size())
+		{
+			findTileQuads(cards, tiles[i], gauss_params, canny_params, MIN_CARD_AREA, tile_quads[i], &tile_cuts[i]);
+		}
+	};
+
+	int thread_count = options.threads > 0 ? options.threads : (int)std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::thread> threads;
+	for (int t = 1; t < std::min<int>(thread_count, (int)tiles.size()); t++)
+	{
+		threads.emplace_back(work);
+	}
+	work();
+	for (auto& thread: threads)
+	{
+		thread.join();
+	}
+
+	// A card inside the overlap of several tiles is found by each of them, the first one counts
+	std::vector<std::vector<cv::Point>> quads;
+	for (const auto& found: tile_quads)
+	{
+		for (const auto& quad: found)
+		{
+			cv::Point2f mid(0, 0);
+			for (const auto& p: quad)
+			{
+				mid += cv::Point2f(p) * 0.25f;
+			}
+
+			bool seen = false;
+			for (const auto& kept: quads)
+			{
+				seen = seen || cv::pointPolygonTest(kept, mid, false) >= 0;
+			}
+			if (!seen)
+			{
+				quads.push_back(quad);
+			}
+		}
+	}
+
+	// Outlines cut by a tile border are fine when another tile holds their card whole,
+	// the others are most likely cards larger than the overlap
+	for (const auto& cuts: tile_cuts)
+	{
+		for (const auto& bounds: cuts)
+		{
+			cv::Point2f mid = (cv::Point2f(bounds.tl()) + cv::Point2f(bounds.br())) * 0.5f;
+			bool whole = false;
+			for (const auto& kept: quads)
+			{
+				whole = whole || cv::pointPolygonTest(kept, mid, false) >= 0;
+			}
+			result.cut_outlines += whole ? 0 : 1;
+		}
+	}
+	result.timings.ms[STAGE_FRONT_END] = clock.lap();
+
+	recognize(color, cards, quads, clock, result);
+
+	if (options.output)
+	{
+		drawOutput(color, result);
+		result.timings.ms[STAGE_OVERLAY] = clock.lap();
+	}
+}
+
+
+void CardDetector::processReduced(ReducedImage& image, DetectionResult& result)
+{
+	result.pipe_out.clear();
+	resetResult(result);
+
+	// Cards are found in the reduced image, with the area limit scaled down to match
+	StageClock clock;
+	const cv::Mat& reduced = image.reduced();
+	const int scale = image.scale();
+	std::vector<std::vector<cv::Point>> quads;
+	findTileQuads(reduced, cv::Rect(cv::Point(0, 0), reduced.size()), gauss_params, canny_params, MIN_CARD_AREA / (scale * scale), quads);
+
+	// Full resolution is only worth decoding for a card whose rank box spans fewer reduced
+	// pixels than the smallest labeled cards offer, the warp upsamples every other card anyway
+	const double min_card_width = double(MIN_RANK_BOX_PIXELS) * CARD_SIZE.width / RANK_BOX.width;
+	bool need_full = false;
+	for (const auto& quad: quads)
+	{
+		for (size_t i = 0; i < quad.size(); i++)
+		{
+			cv::Point side = quad[(i + 1) % quad.size()] - quad[i];
+			need_full = need_full || std::sqrt(double(side.dot(side))) < min_card_width;
+		}
+	}
+
+	if (!need_full || scale == 1)
+	{
+		// Without color the suits are told apart by shape alone
+		result.timings.ms[STAGE_FRONT_END] = clock.lap();
+		recognize(scale == 1 ? image.full() : cv::Mat(), reduced, quads, clock, result, scale);
+		return;
+	}
+
+	// The index strips are warped from the color frame and converted card by card,
+	// graying the whole frame would cost more than the warps at these sizes
+	const cv::Mat& color = image.full();
+	for (auto& quad: quads)
+	{
+		for (auto& p: quad)
+		{
+			p *= scale;
+		}
+	}
+	result.timings.ms[STAGE_FRONT_END] = clock.lap();
+
+	recognize(color, color, quads, clock, result);
+}
@@ -0,0 +1,180 @@
+#include "DetectionWorker.h"
+
+#include <chrono>
+#include <iostream>
+
+
+// Live input that fails for longer than this falls back to the still image
+static const std::chrono::milliseconds LIVE_HICCUP(1000);
+
+static const uint64_t SETTINGS_FIELD_MASK = 0x7FFF;
+static const uint64_t SETTINGS_POSTED = uint64_t(1) << 63;
+
+
+void ParameterMailbox::post(const DetectorSettings& settings)
+{
+	uint64_t packed = SETTINGS_POSTED
+		| (uint64_t(settings.gauss.kernel_size) & SETTINGS_FIELD_MASK)
+		| (uint64_t(settings.gauss.sigma) & SETTINGS_FIELD_MASK) << 15
+		| (uint64_t(settings.canny.low_threshold) & SETTINGS_FIELD_MASK) << 30
+		| (uint64_t(settings.canny.high_threshold) & SETTINGS_FIELD_MASK) << 45;
+
+	m_slot.store(packed, std::memory_order_release);
+}
+
+
+bool ParameterMailbox::fetch(DetectorSettings& settings)
+{
+	uint64_t packed = m_slot.load(std::memory_order_acquire);
+	if (packed == m_fetched)
+	{
+		return false;
+	}
+	m_fetched = packed;
+
+	settings.gauss.kernel_size = int(packed & SETTINGS_FIELD_MASK);
+	settings.gauss.sigma = int(packed >> 15 & SETTINGS_FIELD_MASK);
+	settings.canny.low_threshold = int(packed >> 30 & SETTINGS_FIELD_MASK);
+	settings.canny.high_threshold = int(packed >> 45 & SETTINGS_FIELD_MASK);
+	return true;
+}
+
+
+DetectionWorker::DetectionWorker(CardDetector& detector, FrameSource& still, FrameSource* live)
+	: m_detector(detector),
+	  m_still(still),
+	  m_live(live)
+{
+}
+
+
+DetectionWorker::~DetectionWorker()
+{
+	stop();
+}
+
+
+void DetectionWorker::start(SnapshotCallback on_snapshot)
+{
+	if (m_running)
+	{
+		return;
+	}
+	m_on_snapshot = on_snapshot;
+	m_running = true;
+	m_thread = std::thread(&DetectionWorker::run, this);
+}
+
+
+void DetectionWorker::stop()
+{
+	m_running = false;
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+
+std::shared_ptr<const DetectionSnapshot> DetectionWorker::latest() const
+{
+	return std::atomic_load(&m_latest);
+}
+
+
+void DetectionWorker::run()
+{
+	size_t frame_id = 0;
+	bool was_live = false;
+	auto epoch = std::chrono::steady_clock::now();
+	cv::Mat last_live;
+	auto last_live_at = epoch;
+	int64_t last_live_timestamp = 0;
+
+	while (m_running)
+	{
+		DetectorSettings settings;
+		bool settings_changed = parameters.fetch(settings);
+		if (settings_changed)
+		{
+			m_detector.gauss_params = settings.gauss;
+			m_detector.canny_params = settings.canny;
+		}
+
+		// A fresh header for every frame, capture sources would otherwise decode into a published frame
+		cv::Mat input;
+		StageClock capture_clock;
+		bool want_live = m_use_live && m_live != nullptr;
+		bool live = want_live && m_live->read(input);
+		auto now = std::chrono::steady_clock::now();
+		int64_t timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(now - epoch).count();
+		if (live)
+		{
+			// Recordings, files and frame rings carry their own capture time
+			if (m_live->timestamp() >= 0)
+			{
+				timestamp_us = m_live->timestamp();
+			}
+			last_live = input;
+			last_live_at = now;
+			last_live_timestamp = timestamp_us;
+		}
+		else if (want_live && !last_live.empty() && now - last_live_at < LIVE_HICCUP)
+		{
+			// A capture hiccup keeps the last live frame rather than flashing the still image
+			if (!settings_changed)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+				continue;
+			}
+			input = last_live;
+			timestamp_us = last_live_timestamp;
+			live = true;
+		}
+
+		if (!live)
+		{
+			// Nothing new to show for the still image
+			if (frame_id > 0 && !was_live && !settings_changed)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+				continue;
+			}
+
+			if (!m_still.read(input))
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+				continue;
+			}
+		}
+		was_live = live;
+		double capture_ms = capture_clock.lap();
+
+		auto snapshot = std::make_shared<DetectionSnapshot>();
+		snapshot->frame_id = ++frame_id;
+		snapshot->live = live;
+		snapshot->timestamp_us = timestamp_us;
+		snapshot->input = input;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		try
+		{
+			m_detector.process(snapshot->input, snapshot->result);
+		}
+		catch (const std::exception& e)
+		{
+			// The last good snapshot stays published, a frame that fails would end the thread otherwise
+			std::cerr << "Detection failed on frame " << frame_id << ": " << e.what() << "\n";
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			continue;
+		}
+		snapshot->process_ms = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count() / 1000.0;
+		snapshot->result.timings.ms[STAGE_CAPTURE] = capture_ms;
+
+		if (m_on_snapshot)
+		{
+			m_on_snapshot(*snapshot);
+		}
+		std::atomic_store(&m_latest, std::shared_ptr<const DetectionSnapshot>(std::move(snapshot)));
+	}
+}
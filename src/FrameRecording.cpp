@@ -0,0 +1,201 @@
+#include "FrameRecording.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "opencv2/imgproc.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char RECORDING_MAGIC[8] = { 'C', 'A', 'R', 'D', 'R', 'E', 'C', '\0' };
+static const uint32_t RECORDING_VERSION = 1;
+
+
+static size_t alignedSize(size_t size)
+{
+	return (size + RECORDING_ALIGNMENT - 1) / RECORDING_ALIGNMENT * RECORDING_ALIGNMENT;
+}
+
+
+FrameRecorder::FrameRecorder(const std::string& path)
+	: m_file(path, std::ios::binary | std::ios::trunc),
+	  m_start(std::chrono::steady_clock::now())
+{
+	if (!m_file.is_open())
+	{
+		std::cout << "Cannot open recording " << path << "\n";
+		return;
+	}
+
+	RecordingFileHeader header = {};
+	std::memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+	header.version = RECORDING_VERSION;
+	m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+
+void FrameRecorder::write(const cv::Mat& frame)
+{
+	auto elapsed = std::chrono::steady_clock::now() - m_start;
+	write(frame, std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+}
+
+
+void FrameRecorder::write(const cv::Mat& frame, int64_t timestamp_us)
+{
+	if (!isOpened() || frame.empty())
+	{
+		return;
+	}
+
+	RecordingFrameHeader header = {};
+	header.timestamp_us = timestamp_us;
+	header.rows = frame.rows;
+	header.cols = frame.cols;
+	header.type = frame.type();
+	header.size = frame.total() * frame.elemSize();
+	m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	// Rows go out one at a time so ROIs and padded captures need no intermediate copy
+	size_t row_size = frame.cols * frame.elemSize();
+	for (int y = 0; y < frame.rows; y++)
+	{
+		m_file.write(reinterpret_cast<const char*>(frame.ptr(y)), row_size);
+	}
+
+	static const char padding[RECORDING_ALIGNMENT] = {};
+	m_file.write(padding, alignedSize(header.size) - header.size);
+	m_frame_count++;
+}
+
+
+ReplaySource::ReplaySource(const std::string& path, bool loop)
+	: m_loop(loop)
+{
+	uint8_t* base = nullptr;
+	size_t size = 0;
+
+#ifndef _WIN32
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		std::cout << "Cannot open recording " << path << "\n";
+		return;
+	}
+
+	struct stat st;
+	if (::fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		// Private writable mapping, pages are only copied if a consumer writes into a frame
+		void* mapping = ::mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (mapping != MAP_FAILED)
+		{
+			m_mapping = mapping;
+			m_mapping_size = st.st_size;
+			::madvise(m_mapping, m_mapping_size, MADV_SEQUENTIAL);
+			base = static_cast<uint8_t*>(mapping);
+			size = m_mapping_size;
+		}
+	}
+	::close(fd);
+#else
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (file.is_open())
+	{
+		m_buffer.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(m_buffer.data()), m_buffer.size());
+		base = m_buffer.data();
+		size = m_buffer.size();
+	}
+#endif
+
+	if (base == nullptr || size < sizeof(RecordingFileHeader))
+	{
+		std::cout << "Cannot read recording " << path << "\n";
+		return;
+	}
+
+	const auto* file_header = reinterpret_cast<const RecordingFileHeader*>(base);
+	if (std::memcmp(file_header->magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) != 0 || file_header->version != RECORDING_VERSION)
+	{
+		std::cout << path << " is not a frame recording\n";
+		return;
+	}
+
+	// Index the frames, a truncated final frame is dropped
+	size_t offset = sizeof(RecordingFileHeader);
+	while (offset + sizeof(RecordingFrameHeader) <= size)
+	{
+		Frame frame;
+		std::memcpy(&frame.header, base + offset, sizeof(frame.header));
+		offset += sizeof(RecordingFrameHeader);
+
+		const auto& h = frame.header;
+		size_t expected = (size_t)h.rows * h.cols * CV_ELEM_SIZE(h.type);
+		bool supported = h.type == CV_8UC1 || h.type == CV_8UC3;
+		if (!supported || h.rows <= 0 || h.cols <= 0 || h.size != expected || offset + h.size > size)
+		{
+			break;
+		}
+
+		frame.data = base + offset;
+		m_frames.push_back(frame);
+		offset += alignedSize(h.size);
+	}
+}
+
+
+ReplaySource::~ReplaySource()
+{
+#ifndef _WIN32
+	if (m_mapping != nullptr)
+	{
+		::munmap(m_mapping, m_mapping_size);
+	}
+#endif
+}
+
+
+bool ReplaySource::read(cv::Mat& frame)
+{
+	if (m_next >= m_frames.size())
+	{
+		if (!m_loop || m_frames.empty())
+		{
+			return false;
+		}
+		m_next = 0;
+	}
+
+	const Frame& f = m_frames[m_next++];
+	frame = cv::Mat(f.header.rows, f.header.cols, f.header.type, f.data);
+	m_timestamp = f.header.timestamp_us;
+
+	// Consumers expect BGR, gray recordings are the only frames that get copied.
+	// Into a fresh buffer each time, a consumer may still hold the previous frame.
+	if (frame.type() == CV_8UC1)
+	{
+		cv::Mat converted;
+		cv::cvtColor(frame, converted, cv::COLOR_GRAY2BGR);
+		frame = converted;
+	}
+	return true;
+}
+
+
+double ReplaySource::fps() const
+{
+	if (m_frames.size() < 2)
+	{
+		return 0;
+	}
+
+	int64_t span = m_frames.back().header.timestamp_us - m_frames.front().header.timestamp_us;
+	return span > 0 ? (m_frames.size() - 1) * 1e6 / span : 0;
+}
@@ -0,0 +1,59 @@
+#include "FrameSource.h"
+
+#include "opencv2/imgcodecs.hpp"
+
+
+ImageSource::ImageSource(const std::string& path)
+	: m_image(cv::imread(path))
+{
+}
+
+
+bool ImageSource::read(cv::Mat& frame)
+{
+	frame = m_image;
+	return !frame.empty();
+}
+
+
+CaptureSource::CaptureSource(int camera_index)
+	: m_capture(camera_index)
+{
+}
+
+
+CaptureSource::CaptureSource(const std::string& path, bool loop)
+	: m_capture(path),
+	  m_is_file(true),
+	  m_loop(loop)
+{
+}
+
+
+bool CaptureSource::read(cv::Mat& frame)
+{
+	if (m_capture.read(frame))
+	{
+		return true;
+	}
+
+	// End of file, start over if requested
+	if (m_is_file && m_loop)
+	{
+		m_capture.set(cv::CAP_PROP_POS_FRAMES, 0);
+		return m_capture.read(frame);
+	}
+	return false;
+}
+
+
+double CaptureSource::fps() const
+{
+	return m_capture.get(cv::CAP_PROP_FPS);
+}
+
+
+int64_t CaptureSource::timestamp() const
+{
+	return m_is_file ? (int64_t)(m_capture.get(cv::CAP_PROP_POS_MSEC) * 1000) : -1;
+}
@@ -0,0 +1,308 @@
+#include "GlyphClassifier.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "opencv2/imgproc.hpp"
+
+
+// Scale a glyph to template size and make it binary again, interpolation blurs its outline
+static void scaleGlyph(const cv::Mat& glyph, cv::Size size, cv::Mat& scaled)
+{
+	bool shrink = glyph.cols > size.width || glyph.rows > size.height;
+	cv::resize(glyph, scaled, size, 0, 0, shrink ? cv::INTER_AREA : cv::INTER_LINEAR);
+	cv::threshold(scaled, scaled, 127, 255, cv::THRESH_BINARY);
+}
+
+
+void GlyphClassifier::setTemplates(const std::vector<std::pair<std::string, cv::Mat>>& templates, cv::Size glyph_size)
+{
+	// Allowed templates are kept as bits
+	CV_Assert(templates.size() <= 32);
+
+	m_glyph_size = glyph_size;
+	m_names.clear();
+	m_templates.create((int)templates.size(), glyph_size.area(), CV_32F);
+	m_template_norms.create(1, (int)templates.size(), CV_32F);
+
+	for (size_t i = 0; i < templates.size(); i++)
+	{
+		m_names.push_back(templates[i].first);
+
+		cv::Mat scaled;
+		scaleGlyph(templates[i].second, glyph_size, scaled);
+		cv::Mat row = m_templates.row((int)i);
+		scaled.reshape(1, 1).convertTo(row, CV_32F, 1.0 / 255);
+		m_template_norms.at<float>((int)i) = (float)row.dot(row);
+	}
+
+	// No glyph can be further from its runner-up than the two templates are apart
+	double closest = m_templates.cols / 5.0;
+	for (int a = 0; a < m_templates.rows; a++)
+	{
+		for (int b = a + 1; b < m_templates.rows; b++)
+		{
+			closest = std::min(closest, cv::norm(m_templates.row(a), m_templates.row(b), cv::NORM_L2SQR));
+		}
+	}
+	m_confident_margin = std::max(1, cvRound(closest / 2));
+
+	m_glyphs.release();
+	m_count = 0;
+}
+
+
+size_t GlyphClassifier::add(const cv::Mat& glyph, uint32_t allowed)
+{
+	// Grow by doubling, a frame rarely holds more cards than the one before
+	if ((int)m_count >= m_glyphs.rows)
+	{
+		cv::Mat grown(std::max(16, 2 * m_glyphs.rows), m_templates.cols, CV_32F);
+		if (m_count > 0)
+		{
+			m_glyphs.rowRange(0, (int)m_count).copyTo(grown.rowRange(0, (int)m_count));
+		}
+		m_glyphs = grown;
+	}
+
+	// Ruling out every template would leave nothing to report, fall back to all of them
+	uint32_t all = m_templates.rows >= 32 ? ALL_TEMPLATES : (1u << m_templates.rows) - 1;
+	m_allowed.resize(m_count + 1);
+	m_allowed[m_count] = (allowed & all) != 0 ? allowed & all : all;
+
+	scaleGlyph(glyph, m_glyph_size, m_scaled);
+	cv::Mat row = m_glyphs.row((int)m_count);
+	m_scaled.reshape(1, 1).convertTo(row, CV_32F, 1.0 / 255);
+	return m_count++;
+}
+
+
+void GlyphClassifier::candidates(size_t glyph, int hint, std::vector<int>& order)
+{
+	order.clear();
+	int template_count = m_templates.rows;
+	uint32_t allowed = m_allowed[glyph];
+
+	for (int t = 0; t < template_count; t++)
+	{
+		if (allowed & (1u << t))
+		{
+			order.push_back(t);
+		}
+	}
+	m_stats.pruned += template_count - order.size();
+
+	// The hint goes first, unless its color was ruled out
+	auto hinted = std::find(order.begin(), order.end(), hint);
+	if (hinted != order.end())
+	{
+		std::rotate(order.begin(), hinted, hinted + 1);
+	}
+}
+
+
+float GlyphClassifier::boundedScore(const float* glyph, int t, float bound) const
+{
+	// Checking the bound every few glyph rows keeps the branch out of the inner loop
+	const int block = 4 * m_glyph_size.width;
+	const int size = m_templates.cols;
+	const float* tem = m_templates.ptr<float>(t);
+
+	float ssd = 0;
+	for (int start = 0; start < size && ssd < bound; start += block)
+	{
+		int end = std::min(size, start + block);
+		for (int j = start; j < end; j++)
+		{
+			float d = glyph[j] - tem[j];
+			ssd += d * d;
+		}
+	}
+	return ssd;
+}
+
+
+GlyphClassifier::Match GlyphClassifier::matchBounded(const float* glyph, const std::vector<int>& order)
+{
+	const float confident = (float)confidentMargin();
+
+	Match match;
+	float best = std::numeric_limits<float>::max();
+	float second = std::numeric_limits<float>::max();
+	uint32_t visited = 0;
+	for (int t: order)
+	{
+		// A template that trails the best by the confident margin can neither win nor narrow the margin
+		float bound = best == std::numeric_limits<float>::max() ? best : best + confident;
+		float ssd = boundedScore(glyph, t, bound);
+		visited |= 1u << t;
+
+		if (ssd < best)
+		{
+			second = best;
+			best = ssd;
+			match.label = t;
+			m_stats.scored++;
+		}
+		else
+		{
+			// Abandoned sums are lower bounds, which is all the capped margin needs
+			second = std::min(second, ssd);
+			(ssd < bound ? m_stats.scored : m_stats.abandoned)++;
+		}
+	}
+
+	// Pruned templates only narrow the margin, most of them are abandoned after a few rows
+	for (int t = 0; t < m_templates.rows; t++)
+	{
+		if (!(visited & (1u << t)))
+		{
+			float bound = best + confident;
+			float ssd = boundedScore(glyph, t, bound);
+			second = std::min(second, ssd);
+			(ssd < bound ? m_stats.scored : m_stats.abandoned)++;
+		}
+	}
+
+	match.score = cvRound(best);
+	match.margin = (int)std::max(0.0f, std::min(confident, second - best));
+	match.confidence = match.margin / confident;
+	return match;
+}
+
+
+void GlyphClassifier::scoreAll(const cv::Mat& glyph, std::vector<float>& scores)
+{
+	scaleGlyph(glyph, m_glyph_size, m_scaled);
+	m_scaled.reshape(1, 1).convertTo(m_single, CV_32F, 1.0 / 255);
+
+	scores.resize(m_templates.rows);
+	const float* values = m_single.ptr<float>();
+	for (int t = 0; t < m_templates.rows; t++)
+	{
+		const float* tem = m_templates.ptr<float>(t);
+		float ssd = 0;
+		for (int j = 0; j < m_templates.cols; j++)
+		{
+			float d = values[j] - tem[j];
+			ssd += d * d;
+		}
+		scores[t] = ssd;
+	}
+}
+
+
+GlyphClassifier::Match GlyphClassifier::bestOf(const std::vector<float>& scores) const
+{
+	const float confident = (float)confidentMargin();
+
+	Match match;
+	float best = std::numeric_limits<float>::max();
+	float second = std::numeric_limits<float>::max();
+	for (size_t t = 0; t < scores.size(); t++)
+	{
+		if (scores[t] < best)
+		{
+			second = best;
+			best = scores[t];
+			match.label = (int)t;
+		}
+		else if (scores[t] < second)
+		{
+			second = scores[t];
+		}
+	}
+
+	match.score = std::max(0, cvRound(best));
+	match.margin = (int)std::min(confident, second - best);
+	match.confidence = match.margin / confident;
+	return match;
+}
+
+
+void GlyphClassifier::classify(std::vector<Match>& matches, const std::vector<int>& hints)
+{
+	m_stats = Stats();
+	matches.assign(m_count, Match());
+	if (m_count == 0 || m_templates.empty())
+	{
+		return;
+	}
+
+	auto hintOf = [&](size_t i)
+	{
+		int hint = i < hints.size() ? hints[i] : -1;
+		return hint >= 0 && hint < m_templates.rows ? hint : -1;
+	};
+
+	// Hinted glyphs are resolved right away from their candidates
+	m_orders.resize(m_count);
+	m_unhinted_rows.clear();
+	for (size_t i = 0; i < m_count; i++)
+	{
+		int hint = hintOf(i);
+		candidates(i, hint, m_orders[i]);
+		if (hint >= 0)
+		{
+			matches[i] = matchBounded(m_glyphs.ptr<float>((int)i), m_orders[i]);
+			m_stats.bounded++;
+		}
+		else
+		{
+			m_unhinted_rows.push_back(i);
+		}
+	}
+	if (m_unhinted_rows.empty())
+	{
+		return;
+	}
+
+	cv::Mat glyphs = m_glyphs.rowRange(0, (int)m_count);
+	if (m_unhinted_rows.size() < m_count)
+	{
+		m_unhinted.create((int)m_unhinted_rows.size(), m_glyphs.cols, CV_32F);
+		for (size_t r = 0; r < m_unhinted_rows.size(); r++)
+		{
+			m_glyphs.row((int)m_unhinted_rows[r]).copyTo(m_unhinted.row((int)r));
+		}
+		glyphs = m_unhinted;
+	}
+	m_stats.batched = m_unhinted_rows.size();
+
+	// All glyph-template dot products in one go, the glyph norms are added per row below
+	cv::gemm(glyphs, m_templates, 1, cv::noArray(), 0, m_dots, cv::GEMM_2_T);
+
+	const float* template_norms = m_template_norms.ptr<float>();
+	const float confident = (float)confidentMargin();
+	for (size_t r = 0; r < m_unhinted_rows.size(); r++)
+	{
+		Match& match = matches[m_unhinted_rows[r]];
+		const float* dots = m_dots.ptr<float>((int)r);
+		cv::Mat row = glyphs.row((int)r);
+		float glyph_norm = (float)row.dot(row);
+
+		float best = std::numeric_limits<float>::max();
+		for (int t: m_orders[m_unhinted_rows[r]])
+		{
+			float ssd = glyph_norm + template_norms[t] - 2 * dots[t];
+			if (ssd < best)
+			{
+				best = ssd;
+				match.label = t;
+			}
+		}
+
+		// The product scored every template, those of the other color included, they all count for the margin
+		float second = std::numeric_limits<float>::max();
+		for (int t = 0; t < m_templates.rows; t++)
+		{
+			if (t != match.label)
+			{
+				second = std::min(second, glyph_norm + template_norms[t] - 2 * dots[t]);
+			}
+		}
+		match.score = std::max(0, cvRound(best));
+		match.margin = (int)std::max(0.0f, std::min(confident, second - best));
+		match.confidence = match.margin / confident;
+	}
+}
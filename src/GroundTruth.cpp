@@ -0,0 +1,115 @@
+#include "GroundTruth.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
+
+
+static std::string directoryOf(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+
+std::vector<LabeledImage> loadGroundTruth(const std::string& path)
+{
+	std::vector<LabeledImage> images;
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		std::cout << "Cannot open annotations " << path << "\n";
+		return images;
+	}
+
+	std::string base = directoryOf(path);
+	std::string line;
+	int line_number = 0;
+	while (std::getline(file, line))
+	{
+		line_number++;
+		std::istringstream fields(line);
+		std::string image_path;
+		if (!(fields >> image_path) || image_path[0] == '#')
+		{
+			continue;
+		}
+
+		LabeledCard card;
+		if (!(fields >> card.rank >> card.suit))
+		{
+			std::cout << path << ":" << line_number << ": expected <image> <rank> <suit>\n";
+			continue;
+		}
+
+		int x, y;
+		while (fields >> x >> y)
+		{
+			card.quad.push_back({ x, y });
+		}
+		if (!card.quad.empty() && card.quad.size() != 4)
+		{
+			std::cout << path << ":" << line_number << ": a card outline needs four corners\n";
+			card.quad.clear();
+		}
+
+		// Cards of the same image are listed on consecutive lines
+		if (images.empty() || images.back().path != image_path)
+		{
+			LabeledImage labeled;
+			labeled.path = image_path;
+			labeled.image = cv::imread(base + image_path, cv::IMREAD_COLOR);
+			if (labeled.image.empty())
+			{
+				std::cout << "Cannot read labeled image " << base + image_path << "\n";
+			}
+			images.push_back(labeled);
+		}
+		images.back().cards.push_back(card);
+	}
+
+	// Drop the images that failed to load only now, so their cards are not attributed to a neighbour
+	std::vector<LabeledImage> loaded;
+	for (auto& image: images)
+	{
+		if (!image.image.empty())
+		{
+			loaded.push_back(std::move(image));
+		}
+	}
+	return loaded;
+}
+
+
+Accuracy scoreDetection(const LabeledImage& labels, const DetectionResult& result)
+{
+	Accuracy accuracy;
+	accuracy.expected = labels.cards.size();
+	accuracy.detected = result.cards.size();
+
+	// Every labeled card is claimed by at most one detection
+	std::vector<bool> claimed(labels.cards.size(), false);
+	for (const auto& card: result.cards)
+	{
+		for (size_t i = 0; i < labels.cards.size(); i++)
+		{
+			const LabeledCard& label = labels.cards[i];
+			if (claimed[i] || label.rank != card.rank || label.suit != card.suit)
+			{
+				continue;
+			}
+			if (!label.quad.empty() && cv::pointPolygonTest(label.quad, card.midpoint, false) < 0)
+			{
+				continue;
+			}
+
+			claimed[i] = true;
+			accuracy.correct++;
+			break;
+		}
+	}
+	return accuracy;
+}
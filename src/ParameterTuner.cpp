@@ -0,0 +1,196 @@
+#include "ParameterTuner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+
+static std::vector<int> gridValues(int min, int max, int step)
+{
+	std::vector<int> values;
+	for (int v = min; v <= max; v += std::max(1, step))
+	{
+		values.push_back(v);
+	}
+	if (values.empty() || values.back() != max)
+	{
+		values.push_back(max);
+	}
+	return values;
+}
+
+
+std::vector<TuningResult> sweepSettings(const std::vector<LabeledImage>& images, const TuningGrid& grid, int threads)
+{
+	std::vector<TuningResult> results;
+	for (int kernel: gridValues(grid.kernel_min, grid.kernel_max, grid.kernel_step))
+	{
+		for (int sigma: gridValues(grid.sigma_min, grid.sigma_max, grid.sigma_step))
+		{
+			std::vector<int> thresholds = gridValues(grid.threshold_min, grid.threshold_max, grid.threshold_step);
+			for (int low: thresholds)
+			{
+				for (int high: thresholds)
+				{
+					// Canny treats the larger one as the upper threshold, mirrored pairs behave alike
+					if (low > high)
+					{
+						continue;
+					}
+
+					TuningResult result;
+					result.settings.gauss.kernel_size = kernel | 1;
+					result.settings.gauss.sigma = sigma;
+					result.settings.canny.low_threshold = low;
+					result.settings.canny.high_threshold = high;
+					results.push_back(result);
+				}
+			}
+		}
+	}
+
+	std::atomic<size_t> next{ 0 };
+	std::mutex progress_mutex;
+	size_t done = 0;
+
+	auto work = [&]()
+	{
+		// Every worker loads its own templates, the detector keeps per frame state
+		CardDetector detector;
+		detector.card_views = false;
+		detector.stage_images = false;
+		DetectionResult detection;
+
+		size_t i;
+		while ((i = next++) < results.size())
+		{
+			TuningResult& result = results[i];
+			detector.gauss_params = result.settings.gauss;
+			detector.canny_params = result.settings.canny;
+
+			double total_ms = 0;
+			for (const auto& labeled: images)
+			{
+				auto start = std::chrono::steady_clock::now();
+				detector.process(labeled.image, detection);
+				total_ms += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+				result.accuracy += scoreDetection(labeled, detection);
+			}
+			result.latency_ms = images.empty() ? 0 : total_ms / images.size();
+
+			std::lock_guard<std::mutex> lock(progress_mutex);
+			if (++done % 100 == 0 || done == results.size())
+			{
+				std::cout << "Tried " << done << " of " << results.size() << " settings\n";
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (int t = 0; t < std::max(1, threads); t++)
+	{
+		workers.emplace_back(work);
+	}
+	for (auto& worker: workers)
+	{
+		worker.join();
+	}
+	return results;
+}
+
+
+std::vector<TuningResult> paretoFront(const std::vector<TuningResult>& results)
+{
+	std::vector<TuningResult> sorted = results;
+	std::sort(sorted.begin(), sorted.end(), [](const TuningResult& a, const TuningResult& b)
+	{
+		if (a.latency_ms != b.latency_ms)
+		{
+			return a.latency_ms < b.latency_ms;
+		}
+		return a.accuracy.score() > b.accuracy.score();
+	});
+
+	// Going from fast to slow, a result only belongs to the front if it is more accurate than everything faster
+	std::vector<TuningResult> front;
+	for (const auto& result: sorted)
+	{
+		if (front.empty() || result.accuracy.score() > front.back().accuracy.score())
+		{
+			front.push_back(result);
+		}
+	}
+	return front;
+}
+
+
+const TuningResult& chooseSettings(const std::vector<TuningResult>& front, double budget_ms)
+{
+	// The front is sorted by latency with rising accuracy
+	size_t chosen = 0;
+	for (size_t i = 0; i < front.size(); i++)
+	{
+		if (budget_ms <= 0 || front[i].latency_ms <= budget_ms)
+		{
+			chosen = i;
+		}
+	}
+	return front[chosen];
+}
+
+
+bool saveDetectorSettings(const std::string& path, const DetectorSettings& settings)
+{
+	cv::FileStorage file(path, cv::FileStorage::WRITE);
+	if (!file.isOpened())
+	{
+		return false;
+	}
+
+	file << "gaussian_kernel_size" << settings.gauss.kernel_size;
+	file << "gaussian_sigma" << settings.gauss.sigma;
+	file << "canny_low_threshold" << settings.canny.low_threshold;
+	file << "canny_high_threshold" << settings.canny.high_threshold;
+	return true;
+}
+
+
+bool loadDetectorSettings(const std::string& path, DetectorSettings& settings)
+{
+	cv::FileStorage file(path, cv::FileStorage::READ);
+	if (!file.isOpened())
+	{
+		return false;
+	}
+
+	// Missing entries keep their current value
+	DetectorSettings loaded = settings;
+	if (!file["gaussian_kernel_size"].empty())
+	{
+		file["gaussian_kernel_size"] >> loaded.gauss.kernel_size;
+	}
+	if (!file["gaussian_sigma"].empty())
+	{
+		file["gaussian_sigma"] >> loaded.gauss.sigma;
+	}
+	if (!file["canny_low_threshold"].empty())
+	{
+		file["canny_low_threshold"] >> loaded.canny.low_threshold;
+	}
+	if (!file["canny_high_threshold"].empty())
+	{
+		file["canny_high_threshold"] >> loaded.canny.high_threshold;
+	}
+
+	// Keep to what the trackbars can show
+	loaded.gauss.kernel_size = std::min(9, std::max(1, loaded.gauss.kernel_size)) | 1;
+	loaded.gauss.sigma = std::min(10, std::max(0, loaded.gauss.sigma));
+	loaded.canny.low_threshold = std::min(255, std::max(0, loaded.canny.low_threshold));
+	loaded.canny.high_threshold = std::min(255, std::max(0, loaded.canny.high_threshold));
+	settings = loaded;
+	return true;
+}
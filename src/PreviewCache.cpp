@@ -0,0 +1,46 @@
+#include "PreviewCache.h"
+
+#include <algorithm>
+
+#include "opencv2/imgproc.hpp"
+
+
+const cv::Mat& PreviewCache::get(const std::string& stage, size_t frame_id, const cv::Mat& image, cv::Size max_size)
+{
+	if (m_revision != 0 && stage == m_stage && frame_id == m_frame_id && max_size == m_max_size)
+	{
+		return m_preview;
+	}
+	m_stage = stage;
+	m_frame_id = frame_id;
+	m_max_size = max_size;
+	m_revision++;
+
+	if (image.empty())
+	{
+		m_preview = cv::Mat();
+		return m_preview;
+	}
+
+	double scale = std::min({ 1.0, double(max_size.width) / image.cols, double(max_size.height) / image.rows });
+
+	// Scale first, so the color conversion only touches the pixels that are shown
+	cv::Mat scaled = image;
+	if (scale < 1.0)
+	{
+		cv::Size size(std::max(1, cvRound(image.cols * scale)), std::max(1, cvRound(image.rows * scale)));
+		cv::resize(image, m_scaled, size, 0, 0, cv::INTER_AREA);
+		scaled = m_scaled;
+	}
+
+	if (scaled.channels() == 1)
+	{
+		cv::cvtColor(scaled, m_converted, cv::COLOR_GRAY2BGR);
+		m_preview = m_converted;
+	}
+	else
+	{
+		m_preview = scaled;
+	}
+	return m_preview;
+}
@@ -0,0 +1,353 @@
+#include "RecognitionServer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include "opencv2/imgcodecs.hpp"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+
+std::string encodeResultJson(const DetectionResult& result)
+{
+	std::ostringstream json;
+	json << "{\"cards\":";
+	writeCardsJson(json, result);
+	json << "}";
+	return json.str();
+}
+
+
+static std::vector<uchar> makeResponse(uint32_t status, uint32_t format, uint32_t card_count, const uchar* payload, size_t size, uint64_t process_us)
+{
+	RecognitionResponse header = {};
+	std::memcpy(header.magic, RECOGNITION_RESPONSE_MAGIC, sizeof(header.magic));
+	header.status = status;
+	header.format = format;
+	header.card_count = card_count;
+	header.size = size;
+	header.process_us = process_us;
+
+	std::vector<uchar> bytes(sizeof(header) + size);
+	std::memcpy(bytes.data(), &header, sizeof(header));
+	if (size > 0)
+	{
+		std::memcpy(bytes.data() + sizeof(header), payload, size);
+	}
+	return bytes;
+}
+
+
+RecognitionServer::RecognitionServer(const ServerOptions& options)
+	: m_options(options),
+	  m_queue(options.queue_size)
+{
+}
+
+
+RecognitionServer::~RecognitionServer()
+{
+	stop();
+}
+
+
+static uint32_t responseFormat(const RecognitionRequest& request)
+{
+	return request.format == RESULT_JSON ? RESULT_JSON : RESULT_BINARY;
+}
+
+
+std::vector<uchar> RecognitionServer::handle(CardDetector& detector, Job& job)
+{
+	const RecognitionRequest& request = job.request;
+	uint32_t format = responseFormat(request);
+
+	cv::Mat frame;
+	if (request.kind == REQUEST_ENCODED)
+	{
+		frame = cv::imdecode(job.payload, cv::IMREAD_COLOR);
+	}
+	else
+	{
+		// Raw pixels are used in place
+		frame = cv::Mat(request.rows, request.cols, request.type, job.payload.data());
+		if (frame.channels() == 1)
+		{
+			cv::cvtColor(frame, frame, cv::COLOR_GRAY2BGR);
+		}
+	}
+
+	if (frame.empty())
+	{
+		return makeResponse(STATUS_DECODE_FAILED, format, 0, nullptr, 0, 0);
+	}
+
+	DetectionResult result;
+	auto start = std::chrono::steady_clock::now();
+	detector.process(frame, result);
+	uint64_t process_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+	uint32_t card_count = (uint32_t)result.cards.size();
+	if (format == RESULT_JSON)
+	{
+		std::string json = encodeResultJson(result);
+		return makeResponse(STATUS_OK, format, card_count, reinterpret_cast<const uchar*>(json.data()), json.size(), process_us);
+	}
+
+	std::vector<uchar> records = encodeCardRecords(result);
+	return makeResponse(STATUS_OK, format, card_count, records.data(), records.size(), process_us);
+}
+
+
+void RecognitionServer::work(CardDetector& detector)
+{
+	std::shared_ptr<Job> job;
+	while (m_queue.pop(job))
+	{
+		// A broken frame must not take the worker down, the client waits for an answer
+		try
+		{
+			job->response.set_value(handle(detector, *job));
+		}
+		catch (const cv::Exception& e)
+		{
+			std::cout << "Request failed: " << e.what() << "\n";
+			job->response.set_value(makeResponse(STATUS_DECODE_FAILED, responseFormat(job->request), 0, nullptr, 0, 0));
+		}
+		catch (const std::exception& e)
+		{
+			std::cout << "Request failed: " << e.what() << "\n";
+			job->response.set_value(makeResponse(STATUS_INTERNAL_ERROR, responseFormat(job->request), 0, nullptr, 0, 0));
+		}
+		catch (...)
+		{
+			std::cout << "Request failed\n";
+			job->response.set_value(makeResponse(STATUS_INTERNAL_ERROR, responseFormat(job->request), 0, nullptr, 0, 0));
+		}
+		job.reset();
+	}
+}
+
+
+#ifndef _WIN32
+
+static bool readFully(int fd, void* data, size_t size)
+{
+	char* bytes = static_cast<char*>(data);
+	while (size > 0)
+	{
+		ssize_t n = ::recv(fd, bytes, size, 0);
+		if (n <= 0)
+		{
+			return false;
+		}
+		bytes += n;
+		size -= n;
+	}
+	return true;
+}
+
+
+static bool writeFully(int fd, const void* data, size_t size)
+{
+	const char* bytes = static_cast<const char*>(data);
+	while (size > 0)
+	{
+		ssize_t n = ::send(fd, bytes, size, MSG_NOSIGNAL);
+		if (n <= 0)
+		{
+			return false;
+		}
+		bytes += n;
+		size -= n;
+	}
+	return true;
+}
+
+
+// Raw frame descriptor has to match its payload exactly
+static bool validRequest(const RecognitionRequest& request, uint64_t max_payload)
+{
+	if (std::memcmp(request.magic, RECOGNITION_REQUEST_MAGIC, sizeof(request.magic)) != 0 || request.size > max_payload)
+	{
+		return false;
+	}
+	if (request.kind == REQUEST_ENCODED)
+	{
+		return request.size > 0;
+	}
+	if (request.kind != REQUEST_RAW || request.rows <= 0 || request.cols <= 0)
+	{
+		return false;
+	}
+	if (request.type != CV_8UC1 && request.type != CV_8UC3)
+	{
+		return false;
+	}
+	return request.size == uint64_t(request.rows) * request.cols * CV_ELEM_SIZE(request.type);
+}
+
+
+void RecognitionServer::serveConnection(int fd)
+{
+	RecognitionRequest request;
+	while (!m_stop_requested && readFully(fd, &request, sizeof(request)))
+	{
+		uint32_t format = responseFormat(request);
+
+		// The stream cannot be resynchronized after a malformed header
+		if (!validRequest(request, m_options.max_payload))
+		{
+			auto response = makeResponse(STATUS_BAD_REQUEST, format, 0, nullptr, 0, 0);
+			writeFully(fd, response.data(), response.size());
+			break;
+		}
+
+		auto job = std::make_shared<Job>();
+		job->request = request;
+		job->payload.resize(request.size);
+		if (!readFully(fd, job->payload.data(), job->payload.size()))
+		{
+			break;
+		}
+
+		std::future<std::vector<uchar>> result = job->response.get_future();
+		std::vector<uchar> response;
+		if (m_queue.tryPush(job))
+		{
+			response = result.get();
+		}
+		else
+		{
+			response = makeResponse(STATUS_BUSY, format, 0, nullptr, 0, 0);
+		}
+
+		if (!writeFully(fd, response.data(), response.size()))
+		{
+			break;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_connections_mutex);
+		m_connections.erase(fd);
+	}
+	::close(fd);
+	m_connection_count--;
+}
+
+
+bool RecognitionServer::run()
+{
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (m_options.socket_path.empty() || m_options.socket_path.size() >= sizeof(address.sun_path))
+	{
+		std::cout << "Invalid socket path " << m_options.socket_path << "\n";
+		return false;
+	}
+	std::strncpy(address.sun_path, m_options.socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+	int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	::unlink(m_options.socket_path.c_str());
+	if (listen_fd < 0
+		|| ::bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+		|| ::listen(listen_fd, 16) != 0)
+	{
+		std::cout << "Cannot listen on " << m_options.socket_path << "\n";
+		if (listen_fd >= 0)
+		{
+			::close(listen_fd);
+		}
+		return false;
+	}
+
+	// Every worker loads its own templates, so they share nothing while processing
+	std::vector<std::unique_ptr<CardDetector>> detectors;
+	std::vector<std::thread> workers;
+	for (int i = 0; i < std::max(1, m_options.workers); i++)
+	{
+		detectors.push_back(std::make_unique<CardDetector>());
+		detectors.back()->gauss_params = m_options.gauss;
+		detectors.back()->canny_params = m_options.canny;
+		detectors.back()->card_views = false;
+		detectors.back()->stage_images = false;
+		workers.emplace_back(&RecognitionServer::work, this, std::ref(*detectors.back()));
+	}
+
+	std::cout << "Listening on " << m_options.socket_path << " with " << workers.size() << " workers\n";
+	while (!m_stop_requested)
+	{
+		// Wake up regularly to notice stop()
+		pollfd poll_fd = { listen_fd, POLLIN, 0 };
+		if (::poll(&poll_fd, 1, 200) <= 0)
+		{
+			continue;
+		}
+
+		int fd = ::accept(listen_fd, nullptr, nullptr);
+		if (fd < 0)
+		{
+			continue;
+		}
+
+		if (m_connection_count >= m_options.max_connections)
+		{
+			::close(fd);
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_connections_mutex);
+			m_connections.insert(fd);
+		}
+		m_connection_count++;
+		std::thread(&RecognitionServer::serveConnection, this, fd).detach();
+	}
+
+	::close(listen_fd);
+	::unlink(m_options.socket_path.c_str());
+
+	// Unblock connections waiting for their client, requests already queued are still answered
+	{
+		std::lock_guard<std::mutex> lock(m_connections_mutex);
+		for (int fd: m_connections)
+		{
+			::shutdown(fd, SHUT_RDWR);
+		}
+	}
+	while (m_connection_count > 0)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	m_queue.close();
+	for (auto& worker: workers)
+	{
+		worker.join();
+	}
+	return true;
+}
+
+#else
+
+void RecognitionServer::serveConnection(int)
+{
+}
+
+
+bool RecognitionServer::run()
+{
+	std::cout << "The recognition daemon needs Unix domain sockets, it is not available on this platform\n";
+	return false;
+}
+
+#endif
@@ -0,0 +1,54 @@
+#include "ReducedImage.h"
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
+
+
+ReducedImage::ReducedImage(const std::string& path, int reduction)
+{
+	std::ifstream file(path, std::ios::binary);
+	m_encoded.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	if (m_encoded.empty())
+	{
+		return;
+	}
+
+	switch (reduction)
+	{
+	case 2:
+		m_reduced = cv::imdecode(m_encoded, cv::IMREAD_REDUCED_GRAYSCALE_2);
+		break;
+	case 4:
+		m_reduced = cv::imdecode(m_encoded, cv::IMREAD_REDUCED_GRAYSCALE_4);
+		break;
+	case 8:
+		m_reduced = cv::imdecode(m_encoded, cv::IMREAD_REDUCED_GRAYSCALE_8);
+		break;
+	default:
+		m_full = cv::imdecode(m_encoded, cv::IMREAD_COLOR);
+		m_encoded.clear();
+		if (!m_full.empty())
+		{
+			cv::cvtColor(m_full, m_reduced, cv::COLOR_BGR2GRAY);
+		}
+		return;
+	}
+	m_scale = reduction;
+}
+
+
+const cv::Mat& ReducedImage::full()
+{
+	if (m_full.empty() && !m_encoded.empty())
+	{
+		auto start = std::chrono::steady_clock::now();
+		m_full = cv::imdecode(m_encoded, cv::IMREAD_COLOR);
+		m_encoded = std::vector<uchar>();
+		m_full_decode_ms = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+	}
+	return m_full;
+}
@@ -0,0 +1,111 @@
+#include "Regression.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+
+RegressionReport runRegression(CardDetector& detector, const std::vector<LabeledImage>& images, int passes)
+{
+	RegressionReport report;
+	DetectionResult result;
+
+	bool cross_check = detector.cross_check;
+	detector.cross_check = true;
+	for (const auto& labeled: images)
+	{
+		detector.process(labeled.image, result);
+		Accuracy accuracy = scoreDetection(labeled, result);
+		report.per_image.push_back(accuracy);
+		report.accuracy += accuracy;
+		report.disagreements += result.disagreements;
+	}
+	detector.cross_check = cross_check;
+
+	size_t processed = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < passes; pass++)
+	{
+		for (const auto& labeled: images)
+		{
+			detector.process(labeled.image, result);
+			processed++;
+		}
+	}
+	double elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1e6;
+	report.images_per_sec = elapsed > 0 ? processed / elapsed : 0;
+	return report;
+}
+
+
+bool checkRegression(const RegressionReport& report, const RegressionBaseline& baseline)
+{
+	bool passed = true;
+	if (report.disagreements > 0)
+	{
+		std::cout << "The batched classifier and the per card matcher disagree on " << report.disagreements << " glyphs\n";
+		passed = false;
+	}
+	if (report.accuracy.score() < baseline.accuracy - baseline.accuracy_tolerance)
+	{
+		std::cout << "Accuracy regressed: " << report.accuracy.score() << " against a baseline of " << baseline.accuracy << "\n";
+		passed = false;
+	}
+	if (!baseline.check_throughput)
+	{
+		std::cout << "Throughput not checked, the baseline holds no number for this machine\n";
+	}
+	else if (report.images_per_sec < baseline.images_per_sec * (1 - baseline.throughput_tolerance))
+	{
+		std::cout << "Throughput regressed: " << report.images_per_sec << " images/s against a baseline of " << baseline.images_per_sec << "\n";
+		passed = false;
+	}
+	return passed;
+}
+
+
+bool saveRegressionBaseline(const std::string& path, const RegressionBaseline& baseline)
+{
+	cv::FileStorage file(path, cv::FileStorage::WRITE);
+	if (!file.isOpened())
+	{
+		return false;
+	}
+
+	file << "accuracy" << baseline.accuracy;
+	file << "images_per_sec" << baseline.images_per_sec;
+	file << "accuracy_tolerance" << baseline.accuracy_tolerance;
+	file << "throughput_tolerance" << baseline.throughput_tolerance;
+	file << "check_throughput" << (int)baseline.check_throughput;
+	return true;
+}
+
+
+bool loadRegressionBaseline(const std::string& path, RegressionBaseline& baseline)
+{
+	cv::FileStorage file(path, cv::FileStorage::READ);
+	if (!file.isOpened())
+	{
+		return false;
+	}
+
+	baseline.recorded = !file["accuracy"].empty() && !file["images_per_sec"].empty();
+	if (baseline.recorded)
+	{
+		file["accuracy"] >> baseline.accuracy;
+		file["images_per_sec"] >> baseline.images_per_sec;
+	}
+	if (!file["accuracy_tolerance"].empty())
+	{
+		file["accuracy_tolerance"] >> baseline.accuracy_tolerance;
+	}
+	if (!file["throughput_tolerance"].empty())
+	{
+		file["throughput_tolerance"] >> baseline.throughput_tolerance;
+	}
+	if (!file["check_throughput"].empty())
+	{
+		baseline.check_throughput = (int)file["check_throughput"] != 0;
+	}
+	return true;
+}
@@ -0,0 +1,218 @@
+#include "ResultsStream.h"
+
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+static const char RESULTS_MAGIC[8] = { 'C', 'A', 'R', 'D', 'R', 'E', 'S', '\0' };
+static const uint32_t RESULTS_VERSION = 2;
+
+
+std::vector<uchar> encodeCardRecords(const DetectionResult& result)
+{
+	std::vector<uchar> bytes(result.cards.size() * sizeof(CardRecord));
+	CardRecord* records = reinterpret_cast<CardRecord*>(bytes.data());
+
+	for (size_t i = 0; i < result.cards.size(); i++)
+	{
+		const CardResult& card = result.cards[i];
+		CardRecord record = {};
+
+		for (size_t p = 0; p < 4 && p < card.quad.size(); p++)
+		{
+			record.quad[2 * p] = card.quad[p].x;
+			record.quad[2 * p + 1] = card.quad[p].y;
+		}
+		record.midpoint[0] = card.midpoint.x;
+		record.midpoint[1] = card.midpoint.y;
+		record.rank_score = card.rank_score;
+		record.suit_score = card.suit_score;
+		std::strncpy(record.rank, card.rank.c_str(), sizeof(record.rank) - 1);
+		std::strncpy(record.suit, card.suit.c_str(), sizeof(record.suit) - 1);
+		record.rank_confidence = card.rank_confidence;
+		record.suit_confidence = card.suit_confidence;
+		std::memcpy(&records[i], &record, sizeof(record));
+	}
+	return bytes;
+}
+
+
+void writeJsonString(std::ostream& json, const std::string& text)
+{
+	static const char HEX[] = "0123456789abcdef";
+
+	json << '"';
+	for (char c: text)
+	{
+		switch (c)
+		{
+		case '"':
+			json << "\\\"";
+			break;
+		case '\\':
+			json << "\\\\";
+			break;
+		case '\n':
+			json << "\\n";
+			break;
+		case '\r':
+			json << "\\r";
+			break;
+		case '\t':
+			json << "\\t";
+			break;
+		default:
+			// Bytes of multi-byte UTF-8 sequences pass through as they are
+			if ((unsigned char)c < 0x20)
+			{
+				json << "\\u00" << HEX[(unsigned char)c >> 4] << HEX[c & 0xF];
+			}
+			else
+			{
+				json << c;
+			}
+			break;
+		}
+	}
+	json << '"';
+}
+
+
+void writeCardsJson(std::ostream& json, const DetectionResult& result)
+{
+	json << "[";
+	for (size_t i = 0; i < result.cards.size(); i++)
+	{
+		const CardResult& card = result.cards[i];
+		json << (i > 0 ? "," : "") << "{\"rank\":";
+		writeJsonString(json, card.rank);
+		json << ",\"suit\":";
+		writeJsonString(json, card.suit);
+		json << ",\"rank_score\":" << card.rank_score << ",\"suit_score\":" << card.suit_score
+			 << ",\"rank_confidence\":" << card.rank_confidence << ",\"suit_confidence\":" << card.suit_confidence
+			 << ",\"midpoint\":[" << card.midpoint.x << "," << card.midpoint.y << "]"
+			 << ",\"quad\":[";
+		for (size_t p = 0; p < card.quad.size(); p++)
+		{
+			json << (p > 0 ? "," : "") << "[" << card.quad[p].x << "," << card.quad[p].y << "]";
+		}
+		json << "]}";
+	}
+	json << "]";
+}
+
+
+ResultsWriter::ResultsWriter(const std::string& path, Format format, size_t max_pending)
+	: m_file(path, std::ios::binary | std::ios::trunc),
+	  m_format(format),
+	  m_max_pending(max_pending)
+{
+	if (!m_file.is_open())
+	{
+		std::cout << "Cannot open results file " << path << "\n";
+		return;
+	}
+
+	if (m_format == FORMAT_BINARY)
+	{
+		ResultsFileHeader header = {};
+		std::memcpy(header.magic, RESULTS_MAGIC, sizeof(header.magic));
+		header.version = RESULTS_VERSION;
+		header.stage_count = STAGE_COUNT;
+		m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	}
+	m_thread = std::thread(&ResultsWriter::run, this);
+}
+
+
+ResultsWriter::~ResultsWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_ready.notify_one();
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+
+	if (m_dropped > 0)
+	{
+		std::cout << "Results writer dropped " << m_dropped << " records\n";
+	}
+}
+
+
+void ResultsWriter::write(uint64_t frame_id, int64_t timestamp_us, const DetectionResult& result)
+{
+	if (!isOpened())
+	{
+		return;
+	}
+
+	// Serialized outside the lock, only the append is shared with the writer thread
+	std::string record;
+	if (m_format == FORMAT_JSONL)
+	{
+		std::ostringstream json;
+		json << "{\"frame\":" << frame_id << ",\"timestamp_us\":" << timestamp_us << ",\"timings_ms\":{";
+		for (int s = 0; s < STAGE_COUNT; s++)
+		{
+			json << (s > 0 ? "," : "") << "\"" << STAGE_NAMES[s] << "\":" << result.timings.ms[s];
+		}
+		json << "},\"cards\":";
+		writeCardsJson(json, result);
+		json << "}\n";
+		record = json.str();
+	}
+	else
+	{
+		ResultsFrameRecord header = {};
+		header.frame_id = frame_id;
+		header.timestamp_us = timestamp_us;
+		header.card_count = (uint32_t)result.cards.size();
+		for (int s = 0; s < STAGE_COUNT; s++)
+		{
+			header.stage_ms[s] = (float)result.timings.ms[s];
+		}
+
+		std::vector<uchar> cards = encodeCardRecords(result);
+		record.append(reinterpret_cast<const char*>(&header), sizeof(header));
+		record.append(reinterpret_cast<const char*>(cards.data()), cards.size());
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_pending.size() + record.size() > m_max_pending)
+		{
+			m_dropped++;
+			return;
+		}
+		m_pending += record;
+	}
+	m_ready.notify_one();
+}
+
+
+void ResultsWriter::run()
+{
+	std::string writing;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_ready.wait(lock, [this] { return m_stop || !m_pending.empty(); });
+		if (m_pending.empty() && m_stop)
+		{
+			break;
+		}
+
+		// Swap the buffers so producers can go on appending while this one is on its way to disk
+		writing.swap(m_pending);
+		lock.unlock();
+		m_file.write(writing.data(), writing.size());
+		m_file.flush();
+		writing.clear();
+		lock.lock();
+	}
+}
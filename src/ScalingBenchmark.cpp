@@ -0,0 +1,184 @@
+#include "ScalingBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+#include "opencv2/imgproc.hpp"
+
+// Stages the detector times itself, capture and UI stay empty in a benchmark
+static const Stage PLOTTED_STAGES[] = { STAGE_FRONT_END, STAGE_QUAD_FILTER, STAGE_WARP, STAGE_RANK_MATCH, STAGE_SUIT_MATCH, STAGE_OVERLAY };
+static const cv::Scalar STAGE_COLORS[] = {
+	{ 230, 160, 60 }, { 80, 200, 80 }, { 60, 200, 230 }, { 60, 90, 230 }, { 200, 90, 200 }, { 160, 160, 160 }
+};
+
+
+std::vector<BenchmarkPoint> runScalingBenchmark(CardDetector& detector, SceneGenerator& generator,
+	const std::vector<cv::Size>& sizes, const std::vector<int>& card_counts, int passes)
+{
+	std::vector<BenchmarkPoint> points;
+	DetectionResult result;
+
+	for (const auto& size: sizes)
+	{
+		for (int card_count: card_counts)
+		{
+			SceneOptions options;
+			options.size = size;
+			options.card_count = card_count;
+			options.seed = points.size() + 1;
+			LabeledImage scene = generator.generate(options);
+
+			BenchmarkPoint point;
+			point.size = size;
+			point.card_count = card_count;
+
+			detector.process(scene.image, result);
+			point.accuracy = scoreDetection(scene, result);
+			point.rank_stats = result.rank_stats;
+			point.suit_stats = result.suit_stats;
+
+			for (int pass = 0; pass < passes; pass++)
+			{
+				auto start = std::chrono::steady_clock::now();
+				detector.process(scene.image, result);
+				point.total_ms += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+				for (int s = 0; s < STAGE_COUNT; s++)
+				{
+					point.mean.ms[s] += result.timings.ms[s];
+				}
+			}
+
+			int divisor = std::max(1, passes);
+			point.total_ms /= divisor;
+			for (int s = 0; s < STAGE_COUNT; s++)
+			{
+				point.mean.ms[s] /= divisor;
+			}
+
+			std::cout << size.width << "x" << size.height << ", " << card_count << " cards: "
+					  << point.total_ms << " ms, " << point.accuracy.correct << "/" << point.accuracy.expected << " recognized, "
+					  << point.rank_stats.pruned + point.suit_stats.pruned << " templates pruned, "
+					  << point.rank_stats.abandoned + point.suit_stats.abandoned << " abandoned early\n";
+			points.push_back(point);
+		}
+	}
+	return points;
+}
+
+
+bool writeBenchmarkCsv(const std::string& path, const std::vector<BenchmarkPoint>& points)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	file << "width,height,cards,recognized,detected,total_ms";
+	for (int s = 0; s < STAGE_COUNT; s++)
+	{
+		file << "," << STAGE_NAMES[s] << " ms";
+	}
+	for (const char* glyph: { "rank", "suit" })
+	{
+		file << "," << glyph << " batched," << glyph << " bounded," << glyph << " scored," << glyph << " abandoned," << glyph << " pruned";
+	}
+	file << "\n";
+
+	for (const auto& point: points)
+	{
+		file << point.size.width << "," << point.size.height << "," << point.card_count << ","
+			 << point.accuracy.correct << "," << point.accuracy.detected << "," << point.total_ms;
+		for (int s = 0; s < STAGE_COUNT; s++)
+		{
+			file << "," << point.mean.ms[s];
+		}
+		for (const auto* stats: { &point.rank_stats, &point.suit_stats })
+		{
+			file << "," << stats->batched << "," << stats->bounded << "," << stats->scored << "," << stats->abandoned << "," << stats->pruned;
+		}
+		file << "\n";
+	}
+	return true;
+}
+
+
+cv::Mat plotBenchmark(const std::vector<BenchmarkPoint>& points)
+{
+	// Group the points by scene size, keeping the order they were measured in
+	std::vector<std::vector<const BenchmarkPoint*>> charts;
+	for (const auto& point: points)
+	{
+		if (charts.empty() || charts.back().front()->size != point.size)
+		{
+			charts.push_back({});
+		}
+		charts.back().push_back(&point);
+	}
+
+	const cv::Size chart_size(480, 320);
+	const cv::Rect plot_area(50, 30, 410, 240);
+	const int columns = std::min<int>(3, std::max<size_t>(1, charts.size()));
+	const int chart_rows = ((int)charts.size() + columns - 1) / columns;
+	const int legend_height = 30;
+
+	cv::Mat canvas(std::max(1, chart_rows) * chart_size.height + legend_height, columns * chart_size.width, CV_8UC3, cv::Scalar(40, 40, 40));
+	const int font = cv::FONT_HERSHEY_SIMPLEX;
+
+	for (size_t c = 0; c < charts.size(); c++)
+	{
+		const auto& chart = charts[c];
+		cv::Point origin((int)(c % columns) * chart_size.width, (int)(c / columns) * chart_size.height);
+		cv::Rect area = plot_area + origin;
+
+		double max_ms = 0;
+		for (const auto* point: chart)
+		{
+			max_ms = std::max(max_ms, point->total_ms);
+		}
+		max_ms = max_ms > 0 ? max_ms * 1.1 : 1;
+
+		std::string title = std::to_string(chart.front()->size.width) + "x" + std::to_string(chart.front()->size.height);
+		cv::putText(canvas, title, origin + cv::Point(plot_area.x, 20), font, 0.5, cv::Scalar(230, 230, 230), 1, cv::LINE_AA);
+		cv::rectangle(canvas, area, cv::Scalar(90, 90, 90));
+		cv::putText(canvas, cv::format("%.1f ms", max_ms), origin + cv::Point(2, plot_area.y + 10), font, 0.35, cv::Scalar(200, 200, 200), 1, cv::LINE_AA);
+
+		// Card counts are spaced evenly, they usually grow geometrically
+		auto position = [&](size_t i, double ms)
+		{
+			double x = chart.size() > 1 ? double(i) / (chart.size() - 1) : 0.5;
+			return cv::Point(area.x + cvRound(x * area.width), area.br().y - cvRound(ms / max_ms * area.height));
+		};
+
+		for (size_t i = 0; i < chart.size(); i++)
+		{
+			cv::putText(canvas, std::to_string(chart[i]->card_count), position(i, 0) + cv::Point(-6, 16), font, 0.35, cv::Scalar(200, 200, 200), 1, cv::LINE_AA);
+		}
+
+		for (size_t s = 0; s <= sizeof(PLOTTED_STAGES) / sizeof(PLOTTED_STAGES[0]); s++)
+		{
+			// The last curve is the whole pass
+			bool total = s == sizeof(PLOTTED_STAGES) / sizeof(PLOTTED_STAGES[0]);
+			std::vector<cv::Point> curve;
+			for (size_t i = 0; i < chart.size(); i++)
+			{
+				curve.push_back(position(i, total ? chart[i]->total_ms : chart[i]->mean.ms[PLOTTED_STAGES[s]]));
+			}
+			cv::polylines(canvas, curve, false, total ? cv::Scalar(255, 255, 255) : STAGE_COLORS[s], total ? 2 : 1, cv::LINE_AA);
+		}
+	}
+
+	// Legend along the bottom
+	cv::Point legend(10, canvas.rows - 10);
+	for (size_t s = 0; s <= sizeof(PLOTTED_STAGES) / sizeof(PLOTTED_STAGES[0]); s++)
+	{
+		bool total = s == sizeof(PLOTTED_STAGES) / sizeof(PLOTTED_STAGES[0]);
+		std::string name = total ? "Total" : STAGE_NAMES[PLOTTED_STAGES[s]];
+		cv::line(canvas, legend + cv::Point(0, -4), legend + cv::Point(16, -4), total ? cv::Scalar(255, 255, 255) : STAGE_COLORS[s], 2);
+		cv::putText(canvas, name, legend + cv::Point(20, 0), font, 0.4, cv::Scalar(230, 230, 230), 1, cv::LINE_AA);
+		legend.x += 30 + (int)name.size() * 8;
+	}
+	return canvas;
+}
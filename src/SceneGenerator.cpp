@@ -0,0 +1,209 @@
+#include "SceneGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
+
+// Card faces have the size the detector warps cards to
+static const cv::Size FACE_SIZE(250, 350);
+static const cv::Scalar PAPER(242, 242, 238);
+
+
+SceneGenerator::SceneGenerator(const std::string& template_dir)
+	: m_face_mask(FACE_SIZE, CV_8UC1, cv::Scalar(255))
+{
+	std::vector<std::string> rank_names = {
+		"Ace", "Two", "Three", "Four", "Five", "Six",
+		"Seven", "Eight", "Nine", "Ten", "Jack", "Queen",
+		"King"
+	};
+	for (const auto& rank: rank_names)
+	{
+		m_ranks.push_back({ rank, cv::imread(template_dir + rank + ".png", cv::IMREAD_GRAYSCALE) });
+	}
+
+	std::vector<std::string> suit_names = {
+		"Hearts", "Clubs", "Spades", "Diamonds"
+	};
+	for (const auto& suit: suit_names)
+	{
+		m_suits.push_back({ suit, cv::imread(template_dir + suit + ".png", cv::IMREAD_GRAYSCALE) });
+	}
+
+	m_faces.resize(m_ranks.size() * m_suits.size());
+}
+
+
+// Paint a dark on light glyph into the face in the given ink
+static void stamp(cv::Mat& face, const cv::Mat& glyph, const cv::Rect& area, const cv::Scalar& ink, bool upside_down)
+{
+	if (glyph.empty())
+	{
+		return;
+	}
+
+	cv::Mat scaled;
+	cv::resize(glyph, scaled, area.size(), 0, 0, cv::INTER_AREA);
+	if (upside_down)
+	{
+		cv::flip(scaled, scaled, -1);
+	}
+
+	for (int y = 0; y < area.height; y++)
+	{
+		const uchar* coverage = scaled.ptr<uchar>(y);
+		cv::Vec3b* pixel = face.ptr<cv::Vec3b>(area.y + y) + area.x;
+		for (int x = 0; x < area.width; x++)
+		{
+			// Template white is paper, black is ink
+			int paper = coverage[x];
+			for (int c = 0; c < 3; c++)
+			{
+				pixel[x][c] = cv::saturate_cast<uchar>((pixel[x][c] * paper + ink[c] * (255 - paper)) / 255);
+			}
+		}
+	}
+}
+
+
+cv::Mat SceneGenerator::renderFace(size_t rank, size_t suit)
+{
+	cv::Mat& face = m_faces[rank * m_suits.size() + suit];
+	if (!face.empty())
+	{
+		return face;
+	}
+
+	const std::string& suit_name = m_suits[suit].first;
+	cv::Scalar ink = suit_name == "Hearts" || suit_name == "Diamonds" ? cv::Scalar(40, 30, 200) : cv::Scalar(25, 25, 25);
+
+	face = cv::Mat(FACE_SIZE, CV_8UC3, PAPER);
+
+	// Index inside the rank (0, 0, 35, 55) and suit (0, 55, 35, 45) boxes the detector crops
+	cv::Rect rank_area(6, 6, 24, 40);
+	cv::Rect suit_area(7, 62, 22, 26);
+	stamp(face, m_ranks[rank].second, rank_area, ink, false);
+	stamp(face, m_suits[suit].second, suit_area, ink, false);
+
+	// The same index upside down in the opposite corner and a large pip in the middle
+	stamp(face, m_ranks[rank].second, cv::Rect(FACE_SIZE.width - rank_area.br().x, FACE_SIZE.height - rank_area.br().y, rank_area.width, rank_area.height), ink, true);
+	stamp(face, m_suits[suit].second, cv::Rect(FACE_SIZE.width - suit_area.br().x, FACE_SIZE.height - suit_area.br().y, suit_area.width, suit_area.height), ink, true);
+	stamp(face, m_suits[suit].second, cv::Rect(85, 125, 80, 100), ink, false);
+	return face;
+}
+
+
+LabeledImage SceneGenerator::generate(const SceneOptions& options)
+{
+	cv::RNG rng(options.seed);
+
+	LabeledImage scene;
+	scene.path = "synthetic-" + std::to_string(options.seed);
+	scene.image = cv::Mat(options.size, CV_8UC3, cv::Scalar(48, 44, 42));
+	cv::Mat& image = scene.image;
+
+	// Grid of cells shaped roughly like upright cards
+	int count = std::max(0, options.card_count);
+	double aspect = double(FACE_SIZE.height) / FACE_SIZE.width;
+	int cols = std::max(1, (int)std::ceil(std::sqrt(count * aspect * options.size.width / (double)options.size.height)));
+	int rows = std::max(1, (count + cols - 1) / cols);
+	cv::Size2d cell(options.size.width / (double)cols, options.size.height / (double)rows);
+
+	// Leave room for the rotation and the perspective jitter
+	double card_height = 0.7 * std::min(cell.height, cell.width * aspect);
+	double card_width = card_height / aspect;
+
+	for (int i = 0; i < count; i++)
+	{
+		size_t rank = rng.uniform(0, (int)m_ranks.size());
+		size_t suit = rng.uniform(0, (int)m_suits.size());
+		cv::Mat face = renderFace(rank, suit);
+
+		if (rng.uniform(0.0, 1.0) < options.occlusion)
+		{
+			// Something lying on the lower half of the card, clear of the index and the outline
+			face = face.clone();
+			cv::Point center(rng.uniform(70, 180), rng.uniform(190, 290));
+			cv::Size axes(rng.uniform(15, 45), rng.uniform(15, 45));
+			cv::ellipse(face, center, axes, rng.uniform(0.0, 180.0), 0, 360,
+				cv::Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256)), cv::FILLED, cv::LINE_AA);
+		}
+
+		// Corners in the detector's order: top left, top right, bottom right, bottom left
+		cv::Point2d center((i % cols + 0.5) * cell.width, (i / cols + 0.5) * cell.height);
+		double angle = rng.uniform(-options.max_rotation, options.max_rotation) * CV_PI / 180;
+		double jitter = options.perspective * card_width;
+		std::vector<cv::Point2f> corners;
+		for (cv::Point2d corner: { cv::Point2d(-1, -1), cv::Point2d(1, -1), cv::Point2d(1, 1), cv::Point2d(-1, 1) })
+		{
+			cv::Point2d local(corner.x * card_width / 2 + rng.uniform(-jitter, jitter), corner.y * card_height / 2 + rng.uniform(-jitter, jitter));
+			cv::Point2d rotated(local.x * std::cos(angle) - local.y * std::sin(angle), local.x * std::sin(angle) + local.y * std::cos(angle));
+			corners.push_back(cv::Point2f(center + rotated));
+		}
+
+		// Warp only into the card's bounding box, full scene warps would dominate 8K scenes
+		cv::Rect bounds = cv::boundingRect(corners) & cv::Rect(cv::Point(0, 0), options.size);
+		if (bounds.empty())
+		{
+			continue;
+		}
+
+		std::vector<cv::Point2f> face_corners = {
+			{ 0, 0 }, { FACE_SIZE.width - 1.0f, 0 }, { FACE_SIZE.width - 1.0f, FACE_SIZE.height - 1.0f }, { 0, FACE_SIZE.height - 1.0f }
+		};
+		std::vector<cv::Point2f> local_corners;
+		for (const auto& corner: corners)
+		{
+			local_corners.push_back(corner - cv::Point2f(bounds.tl()));
+		}
+		cv::Mat homography = cv::getPerspectiveTransform(face_corners, local_corners);
+
+		cv::Mat warped, mask;
+		cv::warpPerspective(face, warped, homography, bounds.size(), cv::INTER_LINEAR);
+		cv::warpPerspective(m_face_mask, mask, homography, bounds.size(), cv::INTER_NEAREST);
+		warped.copyTo(image(bounds), mask);
+
+		LabeledCard card;
+		card.rank = m_ranks[rank].first;
+		card.suit = m_suits[suit].first;
+		for (const auto& corner: corners)
+		{
+			card.quad.push_back(cv::Point(cvRound(corner.x), cvRound(corner.y)));
+		}
+		scene.cards.push_back(card);
+	}
+
+	// Light falling off linearly in a random direction, plus sensor noise, in bands to bound the memory of 8K scenes
+	double direction = rng.uniform(0.0, 2 * CV_PI);
+	double diagonal = std::sqrt(double(options.size.area()));
+	double gain_x = std::cos(direction) * options.lighting / diagonal;
+	double gain_y = std::sin(direction) * options.lighting / diagonal;
+	double gain_0 = 1 - std::max(0.0, gain_x * options.size.width) - std::max(0.0, gain_y * options.size.height);
+
+	const int band_rows = 256;
+	cv::Mat noise;
+	for (int band = 0; band < image.rows; band += band_rows)
+	{
+		int band_height = std::min(band_rows, image.rows - band);
+		noise.create(band_height, image.cols, CV_16SC3);
+		rng.fill(noise, cv::RNG::NORMAL, 0, options.noise);
+
+		for (int y = 0; y < band_height; y++)
+		{
+			cv::Vec3b* pixel = image.ptr<cv::Vec3b>(band + y);
+			const cv::Vec3s* grain = noise.ptr<cv::Vec3s>(y);
+			double gain = gain_0 + gain_y * (band + y);
+			for (int x = 0; x < image.cols; x++)
+			{
+				double g = gain + gain_x * x;
+				for (int c = 0; c < 3; c++)
+				{
+					pixel[x][c] = cv::saturate_cast<uchar>(pixel[x][c] * g + grain[x][c]);
+				}
+			}
+		}
+	}
+	return scene;
+}
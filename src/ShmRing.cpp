@@ -0,0 +1,430 @@
+#include "ShmRing.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "opencv2/imgproc.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+static const char SHM_RING_MAGIC[8] = { 'C', 'A', 'R', 'D', 'S', 'H', 'M', '\0' };
+static const uint32_t SHM_RING_VERSION = 2;
+
+
+static size_t alignedSize(size_t size)
+{
+	return (size + SHM_RING_ALIGNMENT - 1) / SHM_RING_ALIGNMENT * SHM_RING_ALIGNMENT;
+}
+
+
+// POSIX shared memory names start with a single slash
+static std::string shmName(const std::string& name)
+{
+	return name.empty() || name[0] == '/' ? name : "/" + name;
+}
+
+
+static ShmSlotHeader* slotAt(uint8_t* base, uint32_t slot_count, uint64_t slot_size, uint64_t sequence)
+{
+	size_t stride = sizeof(ShmSlotHeader) + slot_size;
+	return reinterpret_cast<ShmSlotHeader*>(base + sizeof(ShmRingHeader) + (sequence % slot_count) * stride);
+}
+
+
+// Sleep until the word no longer holds expected, a wake up or the timeout, whichever comes first
+static void waitOn(std::atomic<uint32_t>& word, uint32_t expected, int timeout_ms)
+{
+#ifdef __linux__
+	static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be a plain 32 bit integer");
+	timespec timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+#else
+	if (word.load(std::memory_order_acquire) == expected)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(std::min(timeout_ms, 1)));
+	}
+#endif
+}
+
+
+static void wakeAll(std::atomic<uint32_t>& word)
+{
+#ifdef __linux__
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+	(void)word;
+#endif
+}
+
+
+static int remainingMs(std::chrono::steady_clock::time_point deadline)
+{
+	auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+	return left > 0 ? (int)left : 0;
+}
+
+
+// Frees every slot left READING and wakes the producer, whose consumer is gone
+static void freeReadingSlots(uint8_t* base, uint32_t slot_count, uint64_t slot_size)
+{
+	for (uint32_t i = 0; i < slot_count; i++)
+	{
+		ShmSlotHeader* slot = slotAt(base, slot_count, slot_size, i);
+		uint32_t reading = SLOT_READING;
+		if (slot->state.compare_exchange_strong(reading, SLOT_FREE, std::memory_order_acq_rel))
+		{
+			wakeAll(slot->state);
+		}
+	}
+}
+
+
+/*
+Releases the shared slot once the last cv::Mat referring to it is gone.
+OpenCV calls unmap when the reference count of a matrix drops to zero.
+*/
+class ShmRingSource::SlotAllocator : public cv::MatAllocator
+{
+public:
+	cv::UMatData* allocate(int, const int*, int, void*, size_t*, cv::AccessFlag, cv::UMatUsageFlags) const override
+	{
+		return nullptr;
+	}
+
+	bool allocate(cv::UMatData*, cv::AccessFlag, cv::UMatUsageFlags) const override
+	{
+		return false;
+	}
+
+	void deallocate(cv::UMatData* u) const override
+	{
+		ShmSlotHeader* slot = static_cast<ShmSlotHeader*>(u->userdata);
+		slot->state.store(SLOT_FREE, std::memory_order_release);
+		wakeAll(slot->state);
+		delete u;
+	}
+
+	void unmap(cv::UMatData* u) const override
+	{
+		if (u->urefcount == 0 && u->refcount == 0)
+		{
+			deallocate(u);
+		}
+	}
+};
+
+
+#ifndef _WIN32
+
+ShmRingWriter::ShmRingWriter(const std::string& name, uint32_t slot_count, size_t slot_size)
+	: m_name(shmName(name))
+{
+	slot_size = alignedSize(slot_size);
+	size_t size = sizeof(ShmRingHeader) + slot_count * (sizeof(ShmSlotHeader) + slot_size);
+
+	// Start from an empty ring, a consumer of an old one would otherwise see stale frames
+	::shm_unlink(m_name.c_str());
+	int fd = ::shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0 || slot_count == 0 || ::ftruncate(fd, size) != 0)
+	{
+		std::cout << "Cannot create shared memory ring " << m_name << "\n";
+		if (fd >= 0)
+		{
+			::close(fd);
+			::shm_unlink(m_name.c_str());
+		}
+		return;
+	}
+
+	void* mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		std::cout << "Cannot map shared memory ring " << m_name << "\n";
+		::shm_unlink(m_name.c_str());
+		return;
+	}
+
+	// ftruncate zero fills, so every slot starts out FREE
+	m_base = static_cast<uint8_t*>(mapping);
+	m_size = size;
+
+	ShmRingHeader* header = reinterpret_cast<ShmRingHeader*>(m_base);
+	header->version = SHM_RING_VERSION;
+	header->slot_count = slot_count;
+	header->slot_size = slot_size;
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(header->magic, SHM_RING_MAGIC, sizeof(header->magic));
+}
+
+
+ShmRingWriter::~ShmRingWriter()
+{
+	if (m_base)
+	{
+		::munmap(m_base, m_size);
+		::shm_unlink(m_name.c_str());
+	}
+}
+
+
+bool ShmRingWriter::write(const cv::Mat& frame, int64_t timestamp_us, int timeout_ms)
+{
+	ShmRingHeader* header = reinterpret_cast<ShmRingHeader*>(m_base);
+	size_t row_size = frame.cols * frame.elemSize();
+	size_t size = row_size * frame.rows;
+	if (!isOpened() || frame.empty() || size > header->slot_size)
+	{
+		return false;
+	}
+
+	// Wait until the consumer released the frame that occupied this slot
+	ShmSlotHeader* slot = slotAt(m_base, header->slot_count, header->slot_size, m_sequence);
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	uint32_t state;
+	while ((state = slot->state.load(std::memory_order_acquire)) != SLOT_FREE)
+	{
+		int left = remainingMs(deadline);
+		if (left == 0 && !(state == SLOT_READING && reclaimDeadConsumer()))
+		{
+			return false;
+		}
+		waitOn(slot->state, state, std::max(left, 1));
+	}
+	slot->state.store(SLOT_WRITING, std::memory_order_relaxed);
+
+	uint8_t* payload = reinterpret_cast<uint8_t*>(slot) + sizeof(ShmSlotHeader);
+	for (int y = 0; y < frame.rows; y++)
+	{
+		std::memcpy(payload + y * row_size, frame.ptr(y), row_size);
+	}
+	slot->sequence = m_sequence;
+	slot->timestamp_us = timestamp_us;
+	slot->rows = frame.rows;
+	slot->cols = frame.cols;
+	slot->type = frame.type();
+	slot->size = size;
+	slot->state.store(SLOT_READY, std::memory_order_release);
+
+	header->write_sequence.store(++m_sequence, std::memory_order_release);
+	header->published.fetch_add(1, std::memory_order_release);
+	wakeAll(header->published);
+	return true;
+}
+
+
+bool ShmRingWriter::reclaimDeadConsumer()
+{
+	ShmRingHeader* header = reinterpret_cast<ShmRingHeader*>(m_base);
+	int32_t pid = header->consumer_pid.load(std::memory_order_acquire);
+	if (pid <= 0 || ::kill(pid, 0) == 0 || errno != ESRCH)
+	{
+		return false;
+	}
+
+	std::cout << "Consumer " << pid << " of " << m_name << " is gone, freeing its slots\n";
+	header->consumer_pid.compare_exchange_strong(pid, 0, std::memory_order_acq_rel);
+	freeReadingSlots(m_base, header->slot_count, header->slot_size);
+	return true;
+}
+
+
+ShmRingSource::ShmRingSource(const std::string& name, int timeout_ms)
+	: m_allocator(new SlotAllocator()),
+	  m_timeout_ms(timeout_ms)
+{
+	std::string shm_name = shmName(name);
+	int fd = ::shm_open(shm_name.c_str(), O_RDWR, 0);
+	struct stat info;
+	if (fd < 0 || ::fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(ShmRingHeader))
+	{
+		std::cout << "Cannot open shared memory ring " << shm_name << "\n";
+		if (fd >= 0)
+		{
+			::close(fd);
+		}
+		return;
+	}
+
+	void* mapping = ::mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		std::cout << "Cannot map shared memory ring " << shm_name << "\n";
+		return;
+	}
+
+	const ShmRingHeader* header = static_cast<const ShmRingHeader*>(mapping);
+	size_t expected = sizeof(ShmRingHeader) + header->slot_count * (sizeof(ShmSlotHeader) + header->slot_size);
+	if (std::memcmp(header->magic, SHM_RING_MAGIC, sizeof(header->magic)) != 0
+		|| header->version != SHM_RING_VERSION
+		|| header->slot_count == 0
+		|| expected > (size_t)info.st_size)
+	{
+		std::cout << "Not a frame ring: " << shm_name << "\n";
+		::munmap(mapping, info.st_size);
+		return;
+	}
+
+	m_base = static_cast<uint8_t*>(mapping);
+	m_size = info.st_size;
+	m_slot_count = header->slot_count;
+	m_slot_size = header->slot_size;
+
+	// Only one consumer at a time, whatever an earlier one still held is taken back
+	ShmRingHeader* shared = reinterpret_cast<ShmRingHeader*>(m_base);
+	shared->consumer_pid.store((int32_t)::getpid(), std::memory_order_release);
+	freeReadingSlots(m_base, m_slot_count, m_slot_size);
+
+	// Start with the oldest frame that is still waiting
+	m_sequence = header->write_sequence.load(std::memory_order_acquire);
+	for (uint32_t i = 0; i < m_slot_count; i++)
+	{
+		ShmSlotHeader* slot = slotAt(m_base, m_slot_count, m_slot_size, i);
+		if (slot->state.load(std::memory_order_acquire) == SLOT_READY && slot->sequence < m_sequence)
+		{
+			m_sequence = slot->sequence;
+		}
+	}
+}
+
+
+ShmRingSource::~ShmRingSource()
+{
+	if (m_base)
+	{
+		int32_t pid = (int32_t)::getpid();
+		reinterpret_cast<ShmRingHeader*>(m_base)->consumer_pid.compare_exchange_strong(pid, 0, std::memory_order_acq_rel);
+		::munmap(m_base, m_size);
+	}
+}
+
+
+bool ShmRingSource::read(cv::Mat& frame)
+{
+	if (!isOpened())
+	{
+		return false;
+	}
+
+	ShmRingHeader* header = reinterpret_cast<ShmRingHeader*>(m_base);
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_timeout_ms);
+
+	while (true)
+	{
+		ShmSlotHeader* slot = slotAt(m_base, m_slot_count, m_slot_size, m_sequence);
+		while (true)
+		{
+			// Read the counter first, a frame published after the check below changes it and ends the wait
+			uint32_t published = header->published.load(std::memory_order_acquire);
+			if (slot->state.load(std::memory_order_acquire) == SLOT_READY && slot->sequence == m_sequence)
+			{
+				break;
+			}
+
+			int left = remainingMs(deadline);
+			if (left == 0)
+			{
+				return false;
+			}
+			waitOn(header->published, published, left);
+		}
+		slot->state.store(SLOT_READING, std::memory_order_relaxed);
+		m_sequence++;
+
+		// The descriptor comes from another process, it must describe a frame that fits the slot
+		int rows = slot->rows;
+		int cols = slot->cols;
+		int type = slot->type;
+		bool valid = rows > 0 && cols > 0 && (type == CV_8UC1 || type == CV_8UC3)
+			&& slot->size == uint64_t(rows) * cols * CV_ELEM_SIZE(type)
+			&& slot->size <= m_slot_size;
+		if (!valid)
+		{
+			std::cout << "Skipping a malformed frame in the shared memory ring\n";
+			slot->state.store(SLOT_FREE, std::memory_order_release);
+			wakeAll(slot->state);
+			continue;
+		}
+		m_timestamp = slot->timestamp_us;
+
+		uint8_t* payload = reinterpret_cast<uint8_t*>(slot) + sizeof(ShmSlotHeader);
+		if (type == CV_8UC1)
+		{
+			// Consumers expect BGR, the converted copy lets the slot go right away
+			cv::cvtColor(cv::Mat(rows, cols, type, payload), frame, cv::COLOR_GRAY2BGR);
+			slot->state.store(SLOT_FREE, std::memory_order_release);
+			wakeAll(slot->state);
+			return true;
+		}
+
+		// Wrap the payload in place, the allocator frees the slot with the last reference
+		cv::UMatData* u = new cv::UMatData(m_allocator.get());
+		u->data = u->origdata = payload;
+		u->size = slot->size;
+		u->userdata = slot;
+		u->refcount = 1;
+
+		cv::Mat view(rows, cols, type, payload);
+		view.u = u;
+		view.allocator = m_allocator.get();
+		frame = view;
+		return true;
+	}
+}
+
+#else
+
+ShmRingWriter::ShmRingWriter(const std::string& name, uint32_t, size_t)
+	: m_name(name)
+{
+	std::cout << "Shared memory rings are not available on this platform\n";
+}
+
+
+ShmRingWriter::~ShmRingWriter()
+{
+}
+
+
+bool ShmRingWriter::write(const cv::Mat&, int64_t, int)
+{
+	return false;
+}
+
+
+ShmRingSource::ShmRingSource(const std::string&, int timeout_ms)
+	: m_allocator(new SlotAllocator()),
+	  m_timeout_ms(timeout_ms)
+{
+	std::cout << "Shared memory rings are not available on this platform\n";
+}
+
+
+ShmRingSource::~ShmRingSource()
+{
+}
+
+
+bool ShmRingSource::read(cv::Mat&)
+{
+	return false;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include "StageTimings.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+LatencyHistory::LatencyHistory(size_t capacity)
+{
+	for (auto& series: m_series)
+	{
+		series.ring.resize(std::max<size_t>(capacity, 1));
+		series.ordered.reserve(series.ring.size());
+		series.scratch.reserve(series.ring.size());
+	}
+}
+
+
+void LatencyHistory::add(Stage stage, double ms)
+{
+	Series& series = m_series[stage];
+	series.ring[series.next] = ms;
+	series.next = (series.next + 1) % series.ring.size();
+	series.count = std::min(series.count + 1, series.ring.size());
+	series.ordered_valid = false;
+}
+
+
+std::vector<double>& LatencyHistory::samples(Stage stage)
+{
+	Series& series = m_series[stage];
+	if (!series.ordered_valid)
+	{
+		// Oldest sample sits at next once the ring has wrapped around
+		size_t start = series.count < series.ring.size() ? 0 : series.next;
+
+		series.ordered.clear();
+		for (size_t i = 0; i < series.count; i++)
+		{
+			series.ordered.push_back(series.ring[(start + i) % series.ring.size()]);
+		}
+		series.ordered_valid = true;
+	}
+	return series.ordered;
+}
+
+
+double LatencyHistory::percentile(Stage stage, double p)
+{
+	Series& series = m_series[stage];
+	if (series.count == 0)
+	{
+		return 0;
+	}
+
+	series.scratch.assign(series.ring.begin(), series.ring.begin() + series.count);
+	// Nearest rank
+	double position = std::ceil(p / 100 * series.count) - 1;
+	size_t rank = std::min(series.count - 1, (size_t)std::max(0.0, position));
+	std::nth_element(series.scratch.begin(), series.scratch.begin() + rank, series.scratch.end());
+	return series.scratch[rank];
+}
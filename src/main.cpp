@@ -1,103 +1,717 @@
 #include <iostream>
+#include <algorithm>
 #include <unordered_map>
 #include <array>
+#include <memory>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <tuple>
 
 #include "opencv2/core.hpp"
 #include "opencv2/imgproc.hpp"
 #include "opencv2/imgcodecs.hpp"
 #include "opencv2/highgui.hpp"
+#include "opencv2/videoio.hpp"
 #include "opencv2/core/utils/logger.hpp"
 
-#include "opencv2/gapi.hpp"
-#include "opencv2/gapi/core.hpp"
-#include "opencv2/gapi/imgproc.hpp"
-
 #define CVUI_IMPLEMENTATION
 #include "cvui.h"
 #include "EnhancedWindow.h"
+#include "CardDetector.h"
+#include "FrameSource.h"
+#include "FrameRecording.h"
+#include "DetectionWorker.h"
+#include "PreviewCache.h"
+#include "StageTimings.h"
+#include "RecognitionServer.h"
+#include "ShmRing.h"
+#include "ResultsStream.h"
+#include "ParameterTuner.h"
+#include "Regression.h"
+#include "SceneGenerator.h"
+#include "ScalingBenchmark.h"
+#include "ReducedImage.h"
+#include "BatchPipeline.h"
 
 #define WINDOW_NAME    "Most Constrained Card Detector"
 
-
-struct CannyParameters
+// Stages whose p99 exceeds this are drawn in red
+const double FRAME_BUDGET_MS = 1000.0 / 30;
+
+
+static const char* keys =
+	"{help h usage ? |                    | print this message }"
+	"{image          | cards-numerous.jpg | still image shown when live input is off }"
+	"{camera         | 0                  | index of the camera used for live input }"
+	"{video          |                    | video file used for live input instead of the camera }"
+	"{replay         |                    | raw frame recording used for live input instead of the camera }"
+	"{shm            |                    | shared memory frame ring used for live input instead of the camera }"
+	"{shm-publish    |                    | publish the frames of --video, --replay or the still --image to a shared memory frame ring of this name for --shm }"
+	"{shm-slots      | 4                  | frames the --shm-publish ring holds }"
+	"{record         |                    | dump every live frame to this raw frame recording }"
+	"{output         |                    | write the annotated Output stage to this video file }"
+	"{results        |                    | write the recognized cards of every frame to this file }"
+	"{results-format | jsonl              | format of the results file, jsonl or binary }"
+	"{fourcc         | mp4v               | codec of the output video }"
+	"{headless       |                    | process the input without the UI as fast as possible }"
+	"{tile           | 0                  | with --headless or --batch, filter frames larger than this in overlapping tiles of this size, 0 never }"
+	"{tile-overlap   | 512                | overlap of the --tile tiles, must exceed the largest card in pixels, at most half a tile }"
+	"{reduce         | 1                  | with --headless or --batch, find the cards of --image or every image decoded at 1/2, 1/4 or 1/8 of its resolution }"
+	"{config         | detector.yml       | detector settings loaded at startup and written by --tune }"
+	"{tune           |                    | sweep the detector settings over the images of this annotation file and write the best to --config }"
+	"{tune-budget    | 0                  | latency limit in ms per image for the settings chosen by --tune, 0 for none }"
+	"{regress        |                    | compare accuracy and throughput over the images of this annotation file with --baseline }"
+	"{baseline       | regression-baseline.yml | reference numbers of --regress }"
+	"{update-baseline|                    | store the numbers of this --regress run as the new baseline }"
+	"{passes         | 10                 | timed passes over the labeled images of --regress and every scene of --bench }"
+	"{bench          |                    | time the detector on synthetic scenes of every --bench-sizes and --bench-cards, write a CSV file and a plot next to it }"
+	"{bench-sizes    | 640x480,1280x720,1920x1080,3840x2160,7680x4320 | scene sizes of --bench }"
+	"{bench-cards    | 1,5,10,25,50,100,200 | card counts of --bench }"
+	"{synthesize     |                    | write synthetic scenes and their annotations to this existing directory }"
+	"{scenes         | 20                 | number of scenes written by --synthesize }"
+	"{batch          |                    | recognize the images listed in this file, one per line, printing a JSON line per image }"
+	"{readers        | 2                  | threads decoding the images of --batch }"
+	"{daemon         |                    | serve recognition requests on this Unix domain socket }"
+	"{workers        | 2                  | detector threads of the daemon and of --batch }"
+	"{queue          | 8                  | daemon requests waiting for a worker before new ones are rejected as busy, decoded --batch images waiting for a worker }";
+
+
+// Video sink for the annotated output, opened on the first frame so the size is known
+struct OutputWriter
 {
-	int low_threshold = 0;
-	int high_threshold = 255;
+	std::string path;
+	std::string fourcc;
+	double fps = 30;
+	cv::VideoWriter writer;
+
+	void write(const cv::Mat& frame)
+	{
+		if (path.empty() || frame.empty())
+		{
+			return;
+		}
+
+		if (!writer.isOpened())
+		{
+			int code = cv::VideoWriter::fourcc(fourcc[0], fourcc[1], fourcc[2], fourcc[3]);
+			if (!writer.open(path, code, fps, frame.size(), true))
+			{
+				std::cout << "Cannot open output video " << path << "\n";
+				path.clear();
+				return;
+			}
+		}
+		writer.write(frame);
+	}
 };
 
 
-struct GaussianParameters
+// Daemon instance stopped by SIGINT/SIGTERM
+static RecognitionServer* g_server = nullptr;
+
+static void stopServer(int)
 {
-	int kernel_size = 3;
-	int sigma = 0;
-};
+	if (g_server)
+	{
+		g_server->stop();
+	}
+}
+
 
+// Publisher stopped by SIGINT/SIGTERM
+static volatile std::sig_atomic_t g_stop_publishing = 0;
 
-struct ThresholdParameters
+static void stopPublishing(int)
 {
-	int threshold = 100;
-	int max = 255;
-	int type = cv::THRESH_BINARY;
-};
+	g_stop_publishing = 1;
+}
 
 
-int main() 
-{   
-	// OpenCV config
-	cv::utils::logging::setLogLevel(cv::utils::logging::LOG_LEVEL_WARNING);
+// Copy every frame of the source into a shared memory ring at the pace of the source, the ring is sized by the first frame
+static int runShmPublisher(FrameSource& source, const std::string& name, int slots)
+{
+	double fps = source.fps() > 0 ? source.fps() : 30;
+	auto period = std::chrono::microseconds((int64_t)(1000000 / fps));
+
+	std::signal(SIGINT, stopPublishing);
+	std::signal(SIGTERM, stopPublishing);
+
+	std::unique_ptr<ShmRingWriter> ring;
+	cv::Mat frame;
+	size_t published = 0;
+	size_t dropped = 0;
+	auto start = std::chrono::steady_clock::now();
+	auto next = start;
+	while (!g_stop_publishing && source.read(frame))
+	{
+		if (!ring)
+		{
+			ring = std::make_unique<ShmRingWriter>(name, (uint32_t)slots, frame.total() * frame.elemSize());
+			if (!ring->isOpened())
+			{
+				return 1;
+			}
+			std::cout << "Publishing " << frame.cols << "x" << frame.rows << " frames to " << name << " at " << fps << " fps\n";
+		}
 
-	// "Frame buffer"
-	int window_height = 1080;
-	int window_width = 1920;
-	cv::Size rank_size(30, 45);
+		// Recordings and files pass their own capture times on
+		int64_t timestamp_us = source.timestamp();
+		if (timestamp_us < 0)
+		{
+			timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		}
+		if (ring->write(frame, timestamp_us))
+		{
+			published++;
+		}
+		else
+		{
+			dropped++;
+		}
 
-	cv::Mat frame = cv::Mat(window_height, window_width, CV_8UC3);
+		next += period;
+		std::this_thread::sleep_until(next);
+	}
+
+	std::cout << "Published " << published << " frames, dropped " << dropped << "\n";
+	return published > 0 ? 0 : 1;
+}
 
-	// Source image 
-	cv::Mat source = cv::imread("cards-numerous.jpg");
 
-	// Load rank and suit templates
-	std::vector<std::pair<std::string, cv::Mat>> rank_images = {};
-	std::vector<std::string> rank_names = {
-		"Ace", "Two", "Three", "Four", "Five", "Six",
-		"Seven", "Eight", "Nine", "Ten", "Jack", "Queen",
-		"King"
-	};
+// Open the live input: a frame ring, recording or video file when given, the web cam otherwise
+static std::unique_ptr<FrameSource> openLiveSource(const cv::CommandLineParser& parser, bool loop)
+{
+	std::string shm_name = parser.get<std::string>("shm");
+	std::string replay_path = parser.get<std::string>("replay");
+	std::string video_path = parser.get<std::string>("video");
 
-	for (const auto& rank: rank_names)
+	if (!shm_name.empty())
 	{
-		cv::Mat img = cv::imread("images/" + rank + ".png", cv::IMREAD_GRAYSCALE);
-		cv::Mat resized;
-		cv::resize(img, resized, rank_size);
-		rank_images.push_back({ rank, resized});
+		return std::make_unique<ShmRingSource>(shm_name);
 	}
+	if (!replay_path.empty())
+	{
+		return std::make_unique<ReplaySource>(replay_path, loop);
+	}
+	if (!video_path.empty())
+	{
+		return std::make_unique<CaptureSource>(video_path, loop);
+	}
+	return std::make_unique<CaptureSource>(parser.get<int>("camera"));
+}
+
 
-	std::vector<std::pair<std::string, cv::Mat>> suit_images = {};
-	std::vector<std::string> suit_names = {
-		"Hearts", "Clubs", "Spades", "Diamonds"
+// --tile and --tile-overlap, an overlap of more than half a tile would leave tiles that add nothing
+static TileOptions tileOptions(const cv::CommandLineParser& parser)
+{
+	TileOptions tiling;
+	tiling.tile_size = std::max(0, parser.get<int>("tile"));
+	tiling.overlap = std::max(0, parser.get<int>("tile-overlap"));
+	if (tiling.tile_size > 0 && tiling.overlap > tiling.tile_size / 2)
+	{
+		std::cerr << "--tile-overlap " << tiling.overlap << " exceeds half of --tile " << tiling.tile_size
+				  << ", using " << tiling.tile_size / 2 << ". Cards larger than that are lost\n";
+		tiling.overlap = tiling.tile_size / 2;
+	}
+	return tiling;
+}
+
+
+// Push every frame of the source through the detector without pacing or UI
+static int runHeadless(FrameSource& source, CardDetector& detector, const TileOptions& tiling, OutputWriter& output, FrameRecorder* recorder, ResultsWriter* results, bool single_frame)
+{
+	DetectionResult result;
+	cv::Mat cards_color;
+	size_t frame_count = 0;
+	size_t bytes_copied = 0;
+	size_t cut_outlines = 0;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	StageClock capture_clock;
+	while (source.read(cards_color))
+	{
+		double capture_ms = capture_clock.lap();
+		// Capture time from the source when it keeps one, the time of the read otherwise
+		int64_t timestamp_us = source.timestamp();
+		if (timestamp_us < 0)
+		{
+			timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+		if (recorder != nullptr)
+		{
+			recorder->write(cards_color);
+		}
+
+		detector.processTiled(cards_color, tiling, result);
+		result.timings.ms[STAGE_CAPTURE] = capture_ms;
+		output.write(result.pipe_out["Output"]);
+		bytes_copied += result.bytes_copied;
+		cut_outlines += result.cut_outlines;
+		frame_count++;
+
+		if (results != nullptr)
+		{
+			results->write(frame_count, timestamp_us, result);
+		}
+		capture_clock.lap();
+
+		if (single_frame)
+		{
+			break;
+		}
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count() / 1000.0;
+
+	std::cout << "Processed " << frame_count << " frames in " << elapsed << " ms | "
+			  << "FPS(): " << (elapsed > 0 ? frame_count / (elapsed / 1000) : 0) << " | "
+			  << "Copied per frame (KB): " << (frame_count > 0 ? bytes_copied / 1024.0 / frame_count : 0) << "\n";
+	if (cut_outlines > 0)
+	{
+		std::cerr << cut_outlines << " card sized outlines crossed tile borders without lying whole in any tile, "
+				  << "cards larger than --tile-overlap are lost\n";
+	}
+	return frame_count > 0 ? 0 : 1;
+}
+
+
+// Find the cards of a still image decoded at reduced resolution, the full one is decoded only when a card needs it
+static int runReduced(const std::string& path, int reduction, CardDetector& detector, ResultsWriter* results)
+{
+	auto start = std::chrono::steady_clock::now();
+	ReducedImage image(path, reduction);
+	if (image.empty())
+	{
+		std::cout << "Cannot read " << path << "\n";
+		return 1;
+	}
+	// Stamped like batch results, with the time the image was decoded
+	int64_t decoded_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+	DetectionResult result;
+	detector.processReduced(image, result);
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+
+	if (results != nullptr)
+	{
+		results->write(1, decoded_us, result);
+	}
+	writeCardsJson(std::cout, result);
+	std::cout << "\nFound " << result.cards.size() << " cards in " << elapsed << " ms at 1/" << image.scale() << " resolution"
+			  << (image.fullDecoded() ? ", indexes read at full resolution" : "") << "\n";
+	return 0;
+}
+
+
+// Recognize a list of images with decoding, recognition and output overlapped, then report how busy every stage was
+static int runBatchMode(const std::string& list_path, const BatchOptions& options, ResultsWriter* results)
+{
+	std::vector<std::string> paths = loadImageList(list_path);
+	if (paths.empty())
+	{
+		std::cout << "No images in " << list_path << "\n";
+		return 1;
+	}
+
+	BatchReport report = runBatch(paths, options, std::cout, results);
+
+	// The JSON lines go to stdout, the report to stderr so the two can be separated
+	std::cerr << "Processed " << report.images << " images (" << report.failed << " unreadable) in " << report.elapsed_ms << " ms, "
+			  << (report.elapsed_ms > 0 ? report.images / (report.elapsed_ms / 1000) : 0) << " images/s\n";
+	auto usage = [&](const char* name, const StageUsage& stage)
+	{
+		std::cerr << "  " << name << ": " << stage.threads << " threads, " << cvRound(100 * stage.utilization(report.elapsed_ms)) << "% busy\n";
 	};
+	usage("Read", report.read);
+	usage("Recognize", report.recognize);
+	usage("Write", report.write);
+	if (report.full_decode.threads > 0)
+	{
+		usage("Full decode in workers", report.full_decode);
+	}
+	if (report.cut_outlines > 0)
+	{
+		std::cerr << "  " << report.cut_outlines << " card sized outlines crossed tile borders without lying whole in any tile, "
+				  << "cards larger than --tile-overlap are lost\n";
+	}
+	auto depth = [&](const char* name, const QueueUsage& queue)
+	{
+		std::cerr << "  " << name << " queue: mean " << queue.mean_depth << ", max " << queue.max_depth << " of " << queue.capacity << "\n";
+	};
+	depth("Prefetch", report.prefetch);
+	depth("Results", report.results);
+	return report.failed < report.images ? 0 : 1;
+}
+
+
+// Sweep the detector settings over labeled images and keep the best trade-off
+static int runTuner(const std::string& annotations, const std::string& config_path, double budget_ms)
+{
+	std::vector<LabeledImage> images = loadGroundTruth(annotations);
+	if (images.empty())
+	{
+		std::cout << "No labeled images in " << annotations << "\n";
+		return 1;
+	}
+
+	int threads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<TuningResult> results = sweepSettings(images, TuningGrid(), threads);
+	std::vector<TuningResult> front = paretoFront(results);
+
+	std::cout << "Pareto front over " << images.size() << " images (kernel, sigma, low, high: accuracy, ms per image)\n";
+	for (const auto& result: front)
+	{
+		std::cout << "  " << result.settings.gauss.kernel_size << ", " << result.settings.gauss.sigma << ", "
+				  << result.settings.canny.low_threshold << ", " << result.settings.canny.high_threshold << ": "
+				  << result.accuracy.score() << " (" << result.accuracy.correct << "/" << result.accuracy.expected << " cards, "
+				  << result.accuracy.detected << " detected), " << result.latency_ms << "\n";
+	}
+
+	const TuningResult& chosen = chooseSettings(front, budget_ms);
+	if (!saveDetectorSettings(config_path, chosen.settings))
+	{
+		std::cout << "Cannot write " << config_path << "\n";
+		return 1;
+	}
+	std::cout << "Wrote kernel " << chosen.settings.gauss.kernel_size << ", sigma " << chosen.settings.gauss.sigma
+			  << ", thresholds " << chosen.settings.canny.low_threshold << "-" << chosen.settings.canny.high_threshold
+			  << " to " << config_path << "\n";
+	return 0;
+}
+
+
+// Measure recognition accuracy and throughput over labeled images, failing when either regressed
+static int runRegressionSuite(CardDetector& detector, const std::string& annotations, const std::string& baseline_path, bool update, int passes)
+{
+	std::vector<LabeledImage> images = loadGroundTruth(annotations);
+	if (images.empty())
+	{
+		std::cout << "No labeled images in " << annotations << "\n";
+		return 1;
+	}
+
+	RegressionReport report = runRegression(detector, images, passes);
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		const Accuracy& accuracy = report.per_image[i];
+		std::cout << images[i].path << ": " << accuracy.correct << "/" << accuracy.expected << " cards, "
+				  << accuracy.detected << " detected\n";
+	}
+	std::cout << "Accuracy: " << report.accuracy.score() << " | Images/s: " << report.images_per_sec
+			  << " | Matcher disagreements: " << report.disagreements << "\n";
+
+	RegressionBaseline baseline;
+	bool has_baseline = loadRegressionBaseline(baseline_path, baseline);
+	if (update)
+	{
+		// Tolerances set by hand in the file survive an update
+		baseline.accuracy = report.accuracy.score();
+		baseline.images_per_sec = report.images_per_sec;
+		baseline.recorded = true;
+		if (!saveRegressionBaseline(baseline_path, baseline))
+		{
+			std::cout << "Cannot write " << baseline_path << "\n";
+			return 1;
+		}
+		std::cout << "Updated " << baseline_path << "\n";
+		return 0;
+	}
+
+	if (!has_baseline || !baseline.recorded)
+	{
+		std::cout << "No baseline recorded in " << baseline_path << ", record one with --update-baseline\n";
+		return 1;
+	}
+
+	bool passed = checkRegression(report, baseline);
+	std::cout << (passed ? "PASSED\n" : "FAILED\n");
+	return passed ? 0 : 1;
+}
+
+
+// Comma separated list, sizes are given as <width>x<height>
+static std::vector<std::string> splitList(const std::string& list)
+{
+	std::vector<std::string> items;
+	std::stringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		if (!item.empty())
+		{
+			items.push_back(item);
+		}
+	}
+	return items;
+}
+
+
+// Detector latency per stage over synthetic scenes of growing size and card count
+static int runBenchmark(CardDetector& detector, const std::string& csv_path, const std::string& size_list, const std::string& count_list, int passes)
+{
+	std::vector<cv::Size> sizes;
+	for (const auto& item: splitList(size_list))
+	{
+		cv::Size size;
+		char separator = 0;
+		std::stringstream stream(item);
+		if (!(stream >> size.width >> separator >> size.height) || separator != 'x' || size.area() <= 0)
+		{
+			std::cout << "Invalid scene size " << item << "\n";
+			return 1;
+		}
+		sizes.push_back(size);
+	}
 
-	for (const auto& suit: suit_names)
+	std::vector<int> card_counts;
+	for (const auto& item: splitList(count_list))
 	{
-		suit_images.push_back({suit, cv::imread("images/" + suit + ".png", cv::IMREAD_GRAYSCALE) });
+		card_counts.push_back(std::max(0, std::atoi(item.c_str())));
 	}
 
-	// Image to display 
-	cv::Mat cards_color = source;
+	SceneGenerator generator;
+	std::vector<BenchmarkPoint> points = runScalingBenchmark(detector, generator, sizes, card_counts, passes);
+	if (!writeBenchmarkCsv(csv_path, points))
+	{
+		std::cout << "Cannot write " << csv_path << "\n";
+		return 1;
+	}
 
-	// Gaussian Parameters 
-	GaussianParameters gauss_params; 
+	std::string plot_path = csv_path.substr(0, csv_path.find_last_of('.')) + ".png";
+	cv::imwrite(plot_path, plotBenchmark(points));
+	std::cout << "Wrote " << csv_path << " and " << plot_path << "\n";
+	return 0;
+}
+
+
+// Synthetic scenes with their annotations, usable with --tune and --regress
+static int synthesizeScenes(const std::string& directory, int scene_count)
+{
+	std::string base = directory.empty() || directory.back() == '/' ? directory : directory + "/";
+	std::ofstream annotations(base + "ground-truth.txt");
+	if (!annotations.is_open())
+	{
+		std::cout << "Cannot write annotations to " << directory << "\n";
+		return 1;
+	}
+
+	SceneGenerator generator;
+	cv::RNG rng(scene_count);
+	for (int i = 0; i < scene_count; i++)
+	{
+		SceneOptions options;
+		options.card_count = rng.uniform(1, 21);
+		options.seed = i + 1;
+		LabeledImage scene = generator.generate(options);
+
+		std::string name = cv::format("scene-%03d.png", i);
+		if (!cv::imwrite(base + name, scene.image))
+		{
+			std::cout << "Cannot write " << base + name << "\n";
+			return 1;
+		}
+		for (const auto& card: scene.cards)
+		{
+			annotations << name << " " << card.rank << " " << card.suit;
+			for (const auto& corner: card.quad)
+			{
+				annotations << " " << corner.x << " " << corner.y;
+			}
+			annotations << "\n";
+		}
+	}
+
+	std::cout << "Wrote " << scene_count << " scenes to " << directory << "\n";
+	return 0;
+}
+
+
+int main(int argc, char** argv)
+{
+	cv::CommandLineParser parser(argc, argv, keys);
+	parser.about("Most Constrained Card Detector");
+	if (parser.has("help"))
+	{
+		parser.printMessage();
+		return 0;
+	}
+
+	// OpenCV config
+	cv::utils::logging::setLogLevel(cv::utils::logging::LOG_LEVEL_WARNING);
+
+	// Files are replayed as fast as the pipeline allows, cameras pace themselves
+	bool file_input = !parser.get<std::string>("video").empty() || !parser.get<std::string>("replay").empty();
+	bool shm_input = !parser.get<std::string>("shm").empty();
+	bool headless = parser.has("headless");
+
+	// Detector, loads the rank and suit templates
+	CardDetector detector;
+
+	// Settings edited by the UI and posted to the detector
+	DetectorSettings detector_settings;
+
+	// Gaussian Parameters
+	auto& gauss_params = detector_settings.gauss;
 	gauss_params.kernel_size = 3;
 	gauss_params.sigma = 0;
 
-	// Canny parameters 
-	CannyParameters canny_params; 
+	// Canny parameters
+	auto& canny_params = detector_settings.canny;
 	canny_params.low_threshold = 0;
 	canny_params.high_threshold = 255;
-	
+
+	// Tuned settings replace the defaults
+	std::string config_path = parser.get<std::string>("config");
+	if (!parser.has("tune") && loadDetectorSettings(config_path, detector_settings))
+	{
+		std::cout << "Loaded detector settings from " << config_path << "\n";
+	}
+
+	detector.gauss_params = gauss_params;
+	detector.canny_params = canny_params;
+
+	// Only the UI looks at whole warped cards
+	detector.card_views = !headless && !parser.has("bench") && !parser.has("regress");
+
+	// The regression suite only scores the cards, the benchmark times the overlays as a stage
+	detector.stage_images = !parser.has("regress");
+
+	if (parser.has("tune"))
+	{
+		return runTuner(parser.get<std::string>("tune"), config_path, parser.get<double>("tune-budget"));
+	}
+
+	if (parser.has("bench"))
+	{
+		return runBenchmark(detector, parser.get<std::string>("bench"), parser.get<std::string>("bench-sizes"),
+			parser.get<std::string>("bench-cards"), std::max(1, parser.get<int>("passes")));
+	}
+
+	if (parser.has("synthesize"))
+	{
+		return synthesizeScenes(parser.get<std::string>("synthesize"), std::max(1, parser.get<int>("scenes")));
+	}
+
+	if (parser.has("regress"))
+	{
+		return runRegressionSuite(detector, parser.get<std::string>("regress"), parser.get<std::string>("baseline"),
+			parser.has("update-baseline"), std::max(1, parser.get<int>("passes")));
+	}
+
+	OutputWriter output;
+	output.path = parser.get<std::string>("output");
+	output.fourcc = parser.get<std::string>("fourcc");
+
+	std::unique_ptr<FrameRecorder> recorder;
+	if (!parser.get<std::string>("record").empty())
+	{
+		recorder = std::make_unique<FrameRecorder>(parser.get<std::string>("record"));
+	}
+
+	std::unique_ptr<ResultsWriter> results;
+	if (!parser.get<std::string>("results").empty())
+	{
+		std::string format = parser.get<std::string>("results-format");
+		if (format != "jsonl" && format != "binary")
+		{
+			std::cout << "Unknown results format " << format << "\n";
+			return 1;
+		}
+		results = std::make_unique<ResultsWriter>(parser.get<std::string>("results"),
+			format == "binary" ? ResultsWriter::FORMAT_BINARY : ResultsWriter::FORMAT_JSONL);
+	}
+
+	if (parser.has("batch"))
+	{
+		BatchOptions options;
+		options.readers = std::max(1, parser.get<int>("readers"));
+		options.workers = std::max(1, parser.get<int>("workers"));
+		options.prefetch = (size_t)std::max(1, parser.get<int>("queue"));
+		options.reduction = parser.get<int>("reduce");
+		options.tiling = tileOptions(parser);
+		options.settings = detector_settings;
+		return runBatchMode(parser.get<std::string>("batch"), options, results.get());
+	}
+
+	if (parser.has("daemon"))
+	{
+		ServerOptions options;
+		options.socket_path = parser.get<std::string>("daemon");
+		options.workers = std::max(1, parser.get<int>("workers"));
+		options.queue_size = (size_t)std::max(1, parser.get<int>("queue"));
+		options.gauss = gauss_params;
+		options.canny = canny_params;
+
+		RecognitionServer server(options);
+		g_server = &server;
+		std::signal(SIGINT, stopServer);
+		std::signal(SIGTERM, stopServer);
+		bool served = server.run();
+		g_server = nullptr;
+		return served ? 0 : 1;
+	}
+
+	if (parser.has("shm-publish"))
+	{
+		std::unique_ptr<FrameSource> source;
+		if (file_input)
+		{
+			source = openLiveSource(parser, false);
+		}
+		else
+		{
+			source = std::make_unique<ImageSource>(parser.get<std::string>("image"));
+		}
+		if (!source->isOpened())
+		{
+			std::cout << "Cannot open the frames to publish\n";
+			return 1;
+		}
+		return runShmPublisher(*source, parser.get<std::string>("shm-publish"), std::max(1, parser.get<int>("shm-slots")));
+	}
+
+	if (headless)
+	{
+		TileOptions tiling = tileOptions(parser);
+		tiling.output = !output.path.empty();
+
+		if (!file_input && !shm_input)
+		{
+			if (parser.get<int>("reduce") > 1)
+			{
+				return runReduced(parser.get<std::string>("image"), parser.get<int>("reduce"), detector, results.get());
+			}
+			ImageSource still(parser.get<std::string>("image"));
+			return runHeadless(still, detector, tiling, output, recorder.get(), results.get(), true);
+		}
+
+		auto live = openLiveSource(parser, false);
+		if (!live->isOpened())
+		{
+			std::cout << "Cannot open live input\n";
+			return 1;
+		}
+		output.fps = live->fps() > 0 ? live->fps() : output.fps;
+		return runHeadless(*live, detector, tiling, output, recorder.get(), results.get(), false);
+	}
+
+	// "Frame buffer"
+	int window_height = 1080;
+	int window_width = 1920;
+
+	cv::Mat frame = cv::Mat(window_height, window_width, CV_8UC3);
+
+	// Source image, displayed until the first detection finished
+	ImageSource still(parser.get<std::string>("image"));
+	cv::Mat still_image;
+	still.read(still_image);
+
 	// Create windows
 	EnhancedWindow settings(0, 0, 320, window_height, "Settings");
-	EnhancedWindow image(settings.width(), 0, cards_color.cols + 20, cards_color.rows + 40, "Active Image");
+	EnhancedWindow image(settings.width(), 0, still_image.cols + 20, still_image.rows + 40, "Active Image");
 	EnhancedWindow sub_image(settings.width(), window_height - 500, 350, 500, "Individual Card View");
 
 	// Create image stores
@@ -116,22 +730,6 @@ int main()
 		"Suit Bounded",
 	};
 
-	std::unordered_map<std::string, cv::Mat> card_img_data = {
-		{ "Warped", cv::Mat::zeros(10, 10, CV_8UC3) },
-		{ "Rank", cv::Mat::zeros(10, 10, CV_8UC1)},
-		{ "Rank Thresholded", cv::Mat::zeros(10, 10, CV_8UC1)},
-		{ "Rank Dilated", cv::Mat::zeros(10, 10, CV_8UC1)},
-		{ "Rank Contours", cv::Mat::zeros(10, 10, CV_8UC3)},
-		{ "Rank Bounded", cv::Mat::zeros(10, 10, CV_8UC1)},
-		{ "Rank Final", cv::Mat::zeros(10, 10, CV_8UC1)},
-		{ "Suit", cv::Mat::zeros(10, 10, CV_8UC1)},
-		{ "Suit Thresholded", cv::Mat::zeros(10, 10, CV_8UC1)},
-		{ "Suit Eroded", cv::Mat::zeros(10, 10, CV_8UC1)},
-		{ "Suit Dilated", cv::Mat::zeros(10, 10, CV_8UC1)},
-		{ "Suit Countours", cv::Mat::zeros(10, 10, CV_8UC3)},
-		{ "Suit Bounded", cv::Mat::zeros(10, 10, CV_8UC1)}
-	};
-
 	std::vector<std::string> stage_titles = {
 		"Source",
 		"Blurred",
@@ -142,412 +740,129 @@ int main()
 		"Output"
 	};
 
-	std::unordered_map<std::string, cv::Mat> pipe_out = {
-		{"Source", cv::Mat::zeros(10, 10, CV_8UC1)},
-		{"Blurred", cv::Mat()},
-		{"Equalized", cv::Mat()},
-		{"Binarized", cv::Mat()},
-		{"Edges", cv::Mat()},
-		{"Contours", cv::Mat()},
-		{"Rectangle Contours", cv::Mat()},
-		{"Output", cv::Mat()},
-	};
-
 	// Operating data
 	// Main window
 	int active_image_index = 0;
 	std::string active_stage = "Source";
 	bool save_image = false;
 	bool save_subimage = false;
-	cv::Mat cards;
 	cv::Mat display_image;
+	PreviewCache preview_cache;
 
 	// Sub window
 	int active_card_index = 0;
 	int active_substage_index = 0;
 	std::string active_substage = "Warped";
+	std::tuple<size_t, int, int> shown_sub_view(0, -1, -1);
+	size_t sub_revision = 0;
 	cv::Mat sub_display_image; 
 
-	// Configure web cam parameters 
-	cv::Mat cam_frame; 
-	cv::VideoCapture camera(0);
+	// Stage latency panel
+	LatencyHistory latency;
+	size_t last_timed_frame = 0;
+
+	// Configure live input
+	std::unique_ptr<FrameSource> live = openLiveSource(parser, true);
+
 	bool camera_available = true;
 	bool use_camera = true;
-	if (!camera.isOpened())
+	if (!live->isOpened())
 	{
-		std::cout << "Cannot connect to camera";
+		std::cout << (file_input || shm_input ? "Cannot open live input\n" : "Cannot connect to camera\n");
 		camera_available = false;
+		use_camera = false;
 	}
-	
-	// Init cvui and tell it to create a OpenCV window, i.e. cv::namedWindow(WINDOW_NAME).
-	cvui::init(WINDOW_NAME);
-	auto time = std::chrono::high_resolution_clock::now();
-
-	while (true) 
+	else if (live->fps() > 0)
 	{
-		std::vector<std::unordered_map<std::string, cv::Mat>> card_data = {};
+		output.fps = live->fps();
+	}
 
-		// FPS Tracking 
-		auto now = std::chrono::high_resolution_clock::now();
-		auto time_delta = now - time;
-		time = now;
-		auto frame_time = std::chrono::duration_cast<std::chrono::microseconds>(time_delta).count() / 1000.0;
-		std::cout << "Frame time (ms): " << frame_time << " | "
-				  << "FPS(): " << 1.0 / (frame_time / 1000) << "\n";
+	// Detection runs on its own thread at the rate of the input, the UI only
+	// composes the latest finished snapshot and is refreshed at a fixed rate
+	int wait_time = 15;
 
-		// Read image from camera
-		if (use_camera)
+	DetectionWorker worker(detector, still, camera_available ? live.get() : nullptr);
+	worker.setLive(use_camera);
+	worker.parameters.post(detector_settings);
+	worker.start([&](const DetectionSnapshot& snapshot)
+	{
+		if (snapshot.live && recorder)
 		{
-			camera >> cam_frame;
-			cards_color = cam_frame;
+			recorder->write(snapshot.input);
 		}
-		else
+		output.write(snapshot.result.pipe_out.at("Output"));
+		if (results)
 		{
-			cards_color = source.clone();
+			results->write(snapshot.frame_id, snapshot.timestamp_us, snapshot.result);
 		}
-
-		cv::cvtColor(cards_color, cards, cv::COLOR_BGR2GRAY);
-
-		// Clear background color
-		frame = cv::Scalar(53, 101, 77);
-		if (save_image)
-		{
-			std::stringstream ss;
-			ss << "base_image_stage_" << active_stage << ".png";
-			cv::imwrite(ss.str(), pipe_out[active_stage]);
-			save_image = false;
-		}
-
-		// Resize image window to fit camera frame 
-		int newHeight = cards.rows + 40;
-		int newWidth = cards.cols + 20;
-
-		image.setHeight(newHeight);
-		image.setWidth(newWidth);
-
-		// Instantiate and execute pipeline 
-		cv::GMat g_in;
-		cv::GMat g_blurred = cv::gapi::gaussianBlur(g_in, { gauss_params.kernel_size, gauss_params.kernel_size }, gauss_params.sigma);
-		cv::GMat g_equalized = cv::gapi::equalizeHist(g_blurred);
-		cv::GMat g_edges = cv::gapi::Canny(g_blurred, canny_params.low_threshold, canny_params.high_threshold);
-		cv::GArray<cv::GArray<cv::Point>> g_contours = cv::gapi::findContours(g_edges, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
-		cv::GComputation pipeline(cv::GIn(g_in), cv::GOut(g_blurred, g_equalized, g_edges, g_contours));
+	});
 	
-		// Execute pipeline
-		pipe_out["Source"] = cards;
-		std::vector<std::vector<cv::Point>> contours;
-		pipeline.apply(
-			cv::gin(cards), 
-			cv::gout
-			(
-				pipe_out["Blurred"],
-				pipe_out["Equalized"],
-				pipe_out["Edges"],
-				contours
-			) 
-		);
-
-		std::vector<cv::Rect> boundRect(contours.size());
-		std::vector<cv::Mat> card_images = {};
-		std::vector<cv::Point> card_midpoints = {};
-		std::vector<std::string> card_best_guesses = {};
-		std::vector<std::string> suit_best_guesses = {};
-		std::vector<cv::Point2f> target_pts = {{0, 0}, {0, 349}, {249, 349}, {249, 0}};
-		std::vector<std::vector<cv::Point>> rect_contours = {};
-
-		size_t i = 0;
-		for (auto& c: contours)
-		{
-			std::vector<cv::Point2f> output;
-			std::vector<cv::Point> output_i;
-
-			float e = 0.01 * cv::arcLength(c, true);
-			cv::approxPolyDP(c, output, e, true);
-
-			if (output.size() != 4 || cv::contourArea(output) < 5000) {
-				continue; 
-			}
-
-			float x_sum = 0;
-			float y_sum = 0;
-			for (auto p: output)
-			{
-				output_i.push_back(cv::Point((int)p.x, (int)p.y));
-
-				x_sum += p.x;
-				y_sum += p.y;
-			}
-			cv::Point2f mid(x_sum / 4, y_sum / 4);
-			card_midpoints.push_back(mid);
-			rect_contours.push_back(output_i);
-
-			// Determine semantic location of this point in image
-			std::vector<cv::Point2f> src(4);
-			for (auto p: output)
-			{
-				cv::Point2f delta = mid - p;
-
-				if (delta.x > 0 && delta.y > 0) 
-				{
-					// Top left
-					src[0] = p;
-				}
-				else if (delta.x < 0 && delta.y > 0) 
-				{
-					// Top right
-					src[3] = p;
-				}
-				else if (delta.x > 0 && delta.y < 0)
-				{
-					// Bottom left
-					src[1] = p;
-				}
-				else
-				{
-					// Bottom right
-					src[2] = p;
-				}
-			}
-
-			cv::Mat p = cv::getPerspectiveTransform(src, target_pts);
-			cv::Mat img;
-
-			cv::warpPerspective(cards, img, p, cv::Size(250, 350));
-			card_images.push_back(img); 
-		}
+	// Init cvui and tell it to create a OpenCV window, i.e. cv::namedWindow(WINDOW_NAME).
+	cvui::init(WINDOW_NAME);
+	auto time = std::chrono::high_resolution_clock::now();
 
-		// Extract + identify rank
-		i = 0;
-		int image_index = 0;
-		for (auto& img: card_images)
+	while (true) 
+	{
+		// Kept alive by this reference while the frame is composed, even if detection moves on
+		std::shared_ptr<const DetectionSnapshot> snapshot = worker.latest();
+		if (!snapshot)
 		{
-			// Initialize card data for viewer
-			card_data.push_back(card_img_data);
-			std::string best_match = "";
-
-			auto& card_map = card_data[image_index];
-			
-			// Extract + Identify Rank
-			cv::Rect rank_bounding_box(0, 0, 35, 55);
-			cv::Mat rank_image = img(rank_bounding_box);
-			
-			// Draw bounding box on card
-			cv::Mat card_img_color;
-			cv::cvtColor(img, card_img_color, cv::COLOR_GRAY2BGR);
-			cv::rectangle(card_img_color, rank_bounding_box, CV_RGB(0, 0, 255), 1);
-
-			card_map["Rank"] = rank_image;
-	
-			cv::Mat rank_thresholded;
-			cv::threshold(rank_image, rank_thresholded, 150, 255, cv::THRESH_OTSU);
-			card_map["Rank Threshold"] = rank_thresholded.clone();
-			rank_thresholded = ~rank_thresholded;
-
-			cv::Mat rank_dilated;
-			auto element = cv::getStructuringElement(cv::MORPH_CROSS, cv::Size(4,4));
-			cv::dilate(rank_thresholded, rank_dilated, element);
-			card_map["Rank Dilated"] = ~rank_dilated;
-
-			std::vector<std::vector<cv::Point>> contours; 
-			cv::findContours(rank_dilated, contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
-
-			// Select largest contour
-			std::vector<cv::Point> largest_c;
-			float max_area = 0;
-			for (auto& c: contours)
-			{
-				float area = cv::contourArea(c);
-				if (area > max_area)
-				{
-					max_area = area;
-					largest_c = c;
-				}
-			}
-
-			// Draw bounding box of largest contour
-			cv::Rect bb = cv::boundingRect(largest_c);
-
-			// Draw contours
-			cv::Mat rank_contour_base; 
-			cv::cvtColor(~rank_dilated, rank_contour_base, cv::COLOR_GRAY2BGR);
-
-			if (!rank_contour_base.empty())
-			{
-				for (int i = 0; i < contours.size(); i++)
-				{
-					cv::drawContours(rank_contour_base, contours, i, { 255, 0, 0 }, 1);
-				}
-			}
-			
-			card_map["Rank Contours"] = rank_contour_base;
-
-			cv::Mat bounded_rank = cv::Mat::zeros(rank_image.size(), CV_8UC1);
-			if (!largest_c.empty())
-			{
-				bounded_rank = rank_dilated(bb);
-			}
-			card_map["Rank Bounded"] = ~bounded_rank;
-
-			cv::Mat rank_identity = ~bounded_rank;
-			card_map["Rank Final"] = rank_identity;
-
-			int min_diff = std::numeric_limits<int>().max();
-			float max_conf = 0;
-			for (const auto& img: rank_images)
-			{
-				cv::Mat diff_image; 
-				cv::Mat tem;
-				cv::resize(img.second, tem, rank_identity.size());
-				cv::absdiff(rank_identity, tem, diff_image);
-				int avg_diff = cv::sum(diff_image)[0] / 255;
-				if (avg_diff < min_diff)
-				{
-					min_diff = avg_diff;
-					best_match = img.first;
-				}	
-			}
-
-			std::stringstream ss;
-			ss << "Rank Best Guess: " << best_match;
-			card_best_guesses.push_back(best_match);
-		
-			cv::Rect suit_bounding_box(0, 55, 35, 45);
-			cv::rectangle(card_img_color, suit_bounding_box, CV_RGB(0, 255, 0), 1);
-			card_map["Warped"] = card_img_color;
-
-			// Extract + Identify Suit 
-			cv::Mat suit_image = img(suit_bounding_box);
-			card_map["Suit"] = suit_image;
-		
-			cv::Mat suit_thresholded; 
-			cv::threshold(suit_image, suit_thresholded, 120, 255, cv::THRESH_OTSU);
-			card_map["Suit Threshold"] = suit_thresholded.clone();
-			suit_thresholded = ~suit_thresholded;
-		
-			// Closing op for cutoff club stems
-			cv::Mat suit_dilated;
-			element = cv::getStructuringElement(cv::MORPH_CROSS, cv::Size(1, 1));
-			cv::dilate(suit_thresholded, suit_dilated, element);
-			card_map["Suit Dilated"] = ~suit_dilated;
-
-			cv::Mat suit_eroded;
-			cv::erode(suit_dilated, suit_eroded, element);
-			card_map["Suit Eroded"] = ~suit_eroded;
-			
-			std::vector<std::vector<cv::Point>> suit_contours;
-			cv::findContours(suit_dilated, suit_contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
-
-			// Calculate bb of largest area contour
-			cv::Rect suit_bb; 
-			{
-				std::vector<cv::Point> largest_contour;
-
-				float max_area = 0;
-				for (auto& c : suit_contours)
-				{
-					float area = cv::contourArea(c);
-					if (area > max_area)
-					{
-						max_area = area;
-						largest_contour = c;
-					}
-				}
-				suit_bb = cv::boundingRect(largest_contour);
-			}
-
-			// Draw suit contours
-			cv::Mat suit_contour_img;
-			cv::cvtColor(~suit_dilated, suit_contour_img, cv::COLOR_GRAY2BGR);
-
-			if (!suit_contour_img.empty())
-			{
-				for (int i = 0; i < suit_contours.size(); i++)
-				{
-					cv::drawContours(suit_contour_img, suit_contours, i, { 255, 0, 0 }, 1);
-				}
-			}
-			
-			card_map["Suit Contours"] = suit_contour_img;
-
-			cv::Mat bounded_suit = suit_dilated.clone();
-			if (!suit_bb.empty())
+			if (cv::waitKey(wait_time) == 27)
 			{
-				bounded_suit = suit_dilated(suit_bb);
+				break;
 			}
-			
-			// Final suit 
-			bounded_suit = ~bounded_suit;
-			card_map["Suit Bounded"] = bounded_suit;
-
-			// Identify rank 
-			min_diff = std::numeric_limits<int>().max();
-			std::string suit_match = "";
-			for (const auto& img : suit_images)
-			{
-				cv::Mat diff_image;
-				cv::Mat tem;
-				cv::resize(img.second, tem, bounded_suit.size());
-				cv::absdiff(bounded_suit, tem, diff_image);
-				int avg_diff = cv::sum(diff_image)[0] / 255;
-				if (avg_diff < min_diff)
-				{
-					min_diff = avg_diff;
-					suit_match = img.first;
-				}
-			}
-
-			suit_best_guesses.push_back(suit_match);
-			image_index++;
+			continue;
 		}
 
-		// Generate original contour overlay
-		cv::Mat contour_base;
-		cv::cvtColor(cards, contour_base, cv::COLOR_GRAY2BGR);
+		const auto& pipe_out = snapshot->result.pipe_out;
+		const auto& card_data = snapshot->result.card_data;
 
-		for (size_t i = 0; i < contours.size(); i++)
+		StageClock ui_clock;
+		if (snapshot->frame_id != last_timed_frame)
 		{
-			cv::drawContours(contour_base, contours, i, cv::Scalar(0, 0, 255), 4);
+			for (int s = 0; s < STAGE_UI; s++)
+			{
+				latency.add(Stage(s), snapshot->result.timings.ms[s]);
+			}
+			last_timed_frame = snapshot->frame_id;
 		}
-		pipe_out["Contours"] = contour_base.clone();
 
-		// Generate rectangle contour 
-		cv::Mat rect_contour_base;
-		cv::cvtColor(cards, rect_contour_base, cv::COLOR_GRAY2BGR);
-
-		for (size_t i = 0; i < rect_contours.size(); i++)
-		{
-			cv::drawContours(rect_contour_base, rect_contours, i, cv::Scalar(0, 0, 255), 2);
+		// FPS Tracking 
+		auto now = std::chrono::high_resolution_clock::now();
+		auto time_delta = now - time;
+		time = now;
+		auto frame_time = std::chrono::duration_cast<std::chrono::microseconds>(time_delta).count() / 1000.0;
+		std::cout << "Frame time (ms): " << frame_time << " | "
+				  << "FPS(): " << 1.0 / (frame_time / 1000) << " | "
+				  << "Detection (ms): " << snapshot->process_ms << " | "
+				  << "Copied (KB): " << snapshot->result.bytes_copied / 1024.0 << "\n";
 
-		}
-		pipe_out["Rectangle Contours"] = rect_contour_base.clone();
+		size_t frame_id = snapshot->frame_id;
 
-		for (size_t i = 0; i < rect_contours.size(); i++)
+		// Clear background color, only repainted when cvui needs it
+		cvui::clear(frame, 0x4D6535);
+		if (save_image)
 		{
-			cv::drawContours(cards_color, rect_contours, i, cv::Scalar(0, 0, 255), 2);
-
+			std::stringstream ss;
+			ss << "base_image_stage_" << active_stage << ".png";
+			cv::imwrite(ss.str(), pipe_out.at(active_stage));
+			save_image = false;
 		}
 
-		pipe_out["Output"] = cards_color.clone();
-		// Draw best match rank and suit at center of image 
-		for (size_t i = 0; i < card_images.size(); i++)
-		{
-			auto mid = card_midpoints[i];
-			std::string rank_best_guess = card_best_guesses[i];
-			std::string suit_best_guess = suit_best_guesses[i];
-			
-			cv::Size rank_size = cv::getTextSize(rank_best_guess, cv::FONT_HERSHEY_COMPLEX, 1, 2, nullptr);
-			cv::Point rank_origin = cv::Point(mid.x - rank_size.width / 2, mid.y + rank_size.height / 2);
+		// Select active stage 
+		active_stage = stage_titles[active_image_index];
+		display_image = pipe_out.at(active_stage);
 
-			cv::Size suit_size = cv::getTextSize(suit_best_guess, cv::FONT_HERSHEY_COMPLEX, 0.75, 2, nullptr);
-			cv::Point suit_origin = cv::Point(mid.x - suit_size.width / 2, mid.y + suit_size.height / 2);
+		// Display sized BGR copy of the active stage, only rebuilt for a new stage or frame
+		cv::Size preview_max(window_width - settings.width() - 20, window_height - 40);
+		cv::Mat preview = preview_cache.get(active_stage, frame_id, display_image, preview_max);
 
-			cv::putText(pipe_out["Output"], rank_best_guess, rank_origin, cv::FONT_HERSHEY_COMPLEX, 1.0, CV_RGB(0, 0, 255), 2);
-			cv::putText(pipe_out["Output"], suit_best_guess, suit_origin + cv::Point(0, 24), cv::FONT_HERSHEY_COMPLEX, 0.75, CV_RGB(0, 0, 255), 2);
-		}
+		// Resize image window to fit the preview
+		int newHeight = preview.rows + 40;
+		int newWidth = preview.cols + 20;
 
-		// Select active stage 
-		active_stage = stage_titles[active_image_index];
-		display_image = pipe_out[active_stage];
+		image.setHeight(newHeight);
+		image.setWidth(newWidth);
 
 		// Select active sub image stage
 		active_substage = sub_stage_titles[active_substage_index];
@@ -557,8 +872,8 @@ int main()
 		}
 		else
 		{
-			active_card_index = active_card_index > card_data.size() - 1 ? card_data.size() - 1 : active_card_index;
-			sub_display_image = card_data[active_card_index][active_substage];
+			active_card_index = std::min(active_card_index, (int)card_data.size() - 1);
+			sub_display_image = card_data[active_card_index].at(active_substage);
 		}
 
 		if (save_subimage)
@@ -637,24 +952,29 @@ int main()
 			cvui::space(4);
 			cvui::trackbar(width, &canny_params.high_threshold, 0, 255, 1, "%0.1f", cvui::TRACKBAR_DISCRETE, 1);
 			cvui::space(10);
+
+			cvui::text("Stage Latency (ms)");
+			cvui::space(6);
+			for (int s = 0; s < STAGE_COUNT; s++)
+			{
+				double p50 = latency.percentile(Stage(s), 50);
+				double p99 = latency.percentile(Stage(s), 99);
+				cvui::printf(0.4, 0xCECECE, "%-11s p50 %6.2f  p99 %6.2f", STAGE_NAMES[s], p50, p99);
+				cvui::space(2);
+				cvui::sparkline(latency.samples(Stage(s)), width, 20, p99 > FRAME_BUDGET_MS ? 0xFF4040 : 0x00FF00);
+				cvui::space(4);
+			}
 		}
 		settings.end();
+
+		// Picked up by the detection thread for the next frame
+		worker.parameters.post(detector_settings);
+		worker.setLive(use_camera);
 		
 		image.begin(frame);
 		if (!image.isMinimized())
 		{
-			cv::Mat disp; 
-			if (active_stage == "Contours" || active_stage == "Output" || active_stage == "Rectangle Contours")
-			{
-				disp = display_image;
-			}
-			else
-			{
-				cv::cvtColor(display_image, disp, cv::COLOR_GRAY2BGR);
-			}
-			// Check image type 
-
-			cvui::image(disp);
+			cvui::image(preview, preview_cache.revision());
 		}
 		image.end();
 
@@ -674,16 +994,24 @@ int main()
 			{
 				cvtColor(sub_display_image, disp, cv::COLOR_GRAY2BGR);
 			}
-			cvui::image(disp);
+			// A new revision whenever the frame, card or stage shown changes
+			auto sub_view = std::make_tuple(frame_id, active_card_index, active_substage_index);
+			if (sub_view != shown_sub_view)
+			{
+				shown_sub_view = sub_view;
+				sub_revision++;
+			}
+			cvui::image(disp, sub_revision);
 		}
 		sub_image.end();
 
 		// Update all cvui internal stuff, e.g. handle mouse clicks, and show
 		// everything on the screen.
 		cvui::imshow(WINDOW_NAME, frame);
+		latency.add(STAGE_UI, ui_clock.lap());
 
 		// Check if ESC was pressed
-		if (cv::waitKey(30) == 27) {
+		if (cv::waitKey(wait_time) == 27) {
 			break;
 		}
 	}